@@ -5,10 +5,14 @@ in vec3 normal;
 in vec4 vertexColor;
 out vec4 col;
 
-uniform vec3 lightCol;
-uniform vec3 lightDir;
-uniform vec3 viewPos;
-uniform float lightIntensity;
+layout(std140, binding = 0) uniform Frame
+{
+    mat4 view;
+    mat4 projection;
+    vec4 viewPos;
+    vec4 lightColor; // w: intensity
+    vec4 lightDirection;
+};
 
 const float ambientStrength = 0.3;
 const float diffuseStrength = 0.5;
@@ -17,14 +21,15 @@ const int shininess = 32;
 
 void main()
 {
+    vec3 lightCol = lightColor.xyz, lightDir = lightDirection.xyz;
     vec3 ambient = ambientStrength * lightCol;
     vec3 diffuse = diffuseStrength * max(0, dot(normal, -lightDir)) * lightCol;
 
-    vec3 viewDir = normalize(viewPos - pos);
+    vec3 viewDir = normalize(viewPos.xyz - pos);
     vec3 reflectDir = reflect(lightDir, normal);
     float spec = pow(max(0, dot(viewDir, reflectDir)), shininess);
     vec3 specular = specularStrength * spec * lightCol;
     
-    vec3 lighting = (ambient + diffuse + specular) * lightIntensity;
+    vec3 lighting = (ambient + diffuse + specular) * lightColor.w;
     col = vec4(lighting * vertexColor.xyz, vertexColor.w);
 }
\ No newline at end of file
@@ -5,18 +5,27 @@ layout(location = 1) in vec3 aNormal;
 
 layout(std430, binding = 0) readonly buffer ModelMatrices { mat4 model[];};
 layout(std430, binding = 1) readonly buffer InstanceColors { vec4 color[];};
+layout(std430, binding = 2) readonly buffer VisibleInstances { uint visible[];};
 
 out vec3 pos;
 out vec3 normal;
 out vec4 vertexColor;
 
-uniform mat4 view;
-uniform mat4 projection;
+layout(std140, binding = 0) uniform Frame
+{
+    mat4 view;
+    mat4 projection;
+    vec4 viewPos;
+    vec4 lightColor; // w: intensity
+    vec4 lightDirection;
+};
 
 void main()
 {
-    mat4 instanceModel = model[gl_InstanceID];
-    vertexColor = color[gl_InstanceID];
+    // All batches share the instance buffers, baseInstance is where this draw's visible entries start
+    uint instance = visible[gl_BaseInstance + gl_InstanceID];
+    mat4 instanceModel = model[instance];
+    vertexColor = color[instance];
     
     vec4 worldPos = instanceModel * vec4(aPos, 1.0); pos = worldPos.xyz;
     normal = normalize(transpose(inverse(mat3(instanceModel))) * aNormal);
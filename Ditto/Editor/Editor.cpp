@@ -121,41 +121,92 @@ void Editor::DrawHierarchy()
     {
         if (ImGui::MenuItem("Create Cube"))
         {
-            GameObject* cube = new GameObject("Cube");
-            cube->AddComponent<RendererComponent>(RendererComponent::Type::Cube);
-            engine->scene->gameObjects.push_back(cube); selectedObject = cube;
+            GameObject* cube = engine->scene->CreateGameObject("Cube");
+            cube->AddComponent<RendererComponent>(Resource::cubePath);
+            selectedObject = cube;
         }
         if (ImGui::MenuItem("Create Sphere"))
         {
-            GameObject* sphere = new GameObject("Sphere");
-            sphere->AddComponent<RendererComponent>(RendererComponent::Type::Sphere);
-            engine->scene->gameObjects.push_back(sphere); selectedObject = sphere;
+            GameObject* sphere = engine->scene->CreateGameObject("Sphere");
+            sphere->AddComponent<RendererComponent>(Resource::spherePath);
+            selectedObject = sphere;
         }
         if (ImGui::MenuItem("Create Plane"))
         {
-            GameObject* plane = new GameObject("Plane");
-            plane->AddComponent<RendererComponent>(RendererComponent::Type::Plane);
-            engine->scene->gameObjects.push_back(plane); selectedObject = plane;
+            GameObject* plane = engine->scene->CreateGameObject("Plane");
+            plane->AddComponent<RendererComponent>(Resource::planePath);
+            selectedObject = plane;
         }
         ImGui::EndPopup();
     }
 
-    for (auto obj : engine->scene->gameObjects)
+    // Children are drawn inside their parent's node, a parent that is not an object leaves the child at the top
+    Scene* scene = engine->scene;
+    std::vector<uint32_t> objectIndices = scene->ObjectIndices();
+    std::vector<std::vector<GameObject*>> children(scene->gameObjects.size());
+    std::vector<GameObject*> roots;
+    for (GameObject* obj : scene->gameObjects)
     {
-        bool isSelected = (selectedObject == obj);
+        TransformComponent* transform = obj->GetComponent<TransformComponent>();
+        uint32_t parent = transform && transform->parent < objectIndices.size() ? objectIndices[transform->parent] : UINT32_MAX;
+        if (parent == UINT32_MAX) roots.push_back(obj);
+        else children[parent].push_back(obj);
+    }
+    for (GameObject* obj : roots) DrawHierarchyNode(obj, children, objectIndices);
+
+    ImGui::End();
+
+    if (linkRequested) scene->SetParent(linkChild, linkParent);
+    if (copyRequested) CopySelectedObject();
+    if (deleteRequested) DeleteSelectedObject();
+    linkRequested = copyRequested = deleteRequested = false;
+}
 
-        ImGui::PushID(obj);
-        if (ImGui::Selectable(obj->name.c_str(), isSelected)) selectedObject = obj;
-        ImGui::PopID();
+void Editor::DrawHierarchyNode(GameObject* obj, const std::vector<std::vector<GameObject*>>& children, const std::vector<uint32_t>& objectIndices)
+{
+    const std::vector<GameObject*>& ownChildren = children[objectIndices[obj->id]];
+    ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_OpenOnArrow | ImGuiTreeNodeFlags_DefaultOpen | ImGuiTreeNodeFlags_SpanAvailWidth;
+    if (ownChildren.empty()) flags |= ImGuiTreeNodeFlags_Leaf;
+    if (selectedObject == obj) flags |= ImGuiTreeNodeFlags_Selected;
+
+    ImGui::PushID(obj);
+    bool open = ImGui::TreeNodeEx(obj->name.c_str(), flags);
+    if (ImGui::IsItemClicked() && !ImGui::IsItemToggledOpen()) selectedObject = obj;
 
-        if (ImGui::BeginPopupContextItem())
+    // Dropping an object onto another makes it a child of that object
+    if (ImGui::BeginDragDropSource())
+    {
+        ImGui::SetDragDropPayload("GameObject", &obj, sizeof(obj));
+        ImGui::TextUnformatted(obj->name.c_str());
+        ImGui::EndDragDropSource();
+    }
+    if (ImGui::BeginDragDropTarget())
+    {
+        if (const ImGuiPayload* payload = ImGui::AcceptDragDropPayload("GameObject"))
         {
-            if (ImGui::MenuItem("Copy", "Ctrl+C")) CopySelectedObject();
-            if (ImGui::MenuItem("Delete", "Delete")) DeleteSelectedObject();
+            linkChild = *static_cast<GameObject* const*>(payload->Data); linkParent = obj; linkRequested = true;
         }
+        ImGui::EndDragDropTarget();
     }
 
-    ImGui::End();
+    if (ImGui::BeginPopupContextItem())
+    {
+        if (ImGui::MenuItem("Copy", "Ctrl+C")) copyRequested = true;
+        if (ImGui::MenuItem("Delete", "Delete")) deleteRequested = true;
+        TransformComponent* transform = obj->GetComponent<TransformComponent>();
+        if (ImGui::MenuItem("Unparent", nullptr, false, transform && transform->parent != TransformComponent::noParent))
+        {
+            linkChild = obj; linkParent = nullptr; linkRequested = true;
+        }
+        ImGui::EndPopup();
+    }
+
+    if (open)
+    {
+        for (GameObject* child : ownChildren) DrawHierarchyNode(child, children, objectIndices);
+        ImGui::TreePop();
+    }
+    ImGui::PopID();
 }
 
 void Editor::DrawScene()
@@ -245,6 +296,7 @@ void Editor::DrawPopups()
             {
                 if (engine->scene->LoadScene(loadPathBuffer))
                 {
+                    selectedObject = nullptr;
                     strcpy_s(sceneNameBuffer, engine->scene->name.c_str());
                     ImGui::CloseCurrentPopup();
                 }
@@ -272,8 +324,7 @@ void Editor::DeleteSelectedObject()
 {
     if (selectedObject && engine && engine->scene)
     {
-        auto& gameObjects = engine->scene->gameObjects;
-        gameObjects.erase(std::remove(gameObjects.begin(), gameObjects.end(), selectedObject), gameObjects.end());
-        delete selectedObject; selectedObject = engine->scene->gameObjects.empty() ? nullptr : engine->scene->gameObjects.back();
+        engine->scene->DestroyGameObject(selectedObject);
+        selectedObject = engine->scene->gameObjects.empty() ? nullptr : engine->scene->gameObjects.back();
     }
 }
\ No newline at end of file
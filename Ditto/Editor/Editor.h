@@ -1,4 +1,6 @@
 #pragma once
+#include <vector>
+#include <cstdint>
 #include "../3rdParty/ImGui/imgui.h"
 
 struct Engine;
@@ -9,11 +11,14 @@ struct Editor
     GameObject* selectedObject = nullptr;
     char sceneNameBuffer[16] = "Default";
     bool showHierarchy, showScene, showInspector, showSavePopup, showLoadPopup;
+    // Tree edits requested while the hierarchy is drawn, applied once the tree is done with the objects
+    GameObject* linkChild = nullptr; GameObject* linkParent = nullptr; bool linkRequested = false, copyRequested = false, deleteRequested = false;
     Editor(void* window);
     ~Editor();
     void Draw();
     void DrawToolbar();
     void DrawHierarchy();
+    void DrawHierarchyNode(GameObject* obj, const std::vector<std::vector<GameObject*>>& children, const std::vector<uint32_t>& objectIndices);
     void DrawScene();
     void DrawInspector();
     void DrawPopups();
@@ -0,0 +1,63 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <utility>
+
+// Sparse set keyed by entity id: components of one type live contiguously in dense, sparse maps an entity
+// to its dense slot. Removal swaps the last element into the hole, so pointers are only stable until the
+// next Add or Remove on the same pool.
+template<typename T>
+struct ComponentPool
+{
+    using Type = T;
+    static constexpr uint32_t invalid = UINT32_MAX;
+
+    std::vector<T> dense;
+    std::vector<uint32_t> entities, sparse;
+
+    size_t Size() const { return dense.size(); }
+    bool Has(uint32_t entity) const { return entity < sparse.size() && sparse[entity] != invalid; }
+    T* Get(uint32_t entity) { return Has(entity) ? &dense[sparse[entity]] : nullptr; }
+    const T* Get(uint32_t entity) const { return Has(entity) ? &dense[sparse[entity]] : nullptr; }
+
+    template<typename... Args>
+    T* Add(uint32_t entity, Args&&... args)
+    {
+        if (Has(entity)) return Get(entity);
+        if (entity >= sparse.size()) sparse.resize(entity + 1, invalid);
+        sparse[entity] = static_cast<uint32_t>(dense.size());
+        entities.push_back(entity);
+        dense.emplace_back(std::forward<Args>(args)...);
+        return &dense.back();
+    }
+
+    void Remove(uint32_t entity)
+    {
+        if (!Has(entity)) return;
+        uint32_t index = sparse[entity], last = static_cast<uint32_t>(dense.size() - 1);
+        if (index != last)
+        {
+            dense[index] = std::move(dense[last]);
+            entities[index] = entities[last];
+            sparse[entities[index]] = index;
+        }
+        dense.pop_back(); entities.pop_back();
+        sparse[entity] = invalid;
+    }
+
+    // Bulk load in two steps: Resize sizes dense and entities so ranges of both can be filled in parallel, then
+    // IndexEntities rebuilds sparse from the entity column. It fails on an entity out of range or listed twice.
+    void Resize(size_t count) { dense.resize(count); entities.resize(count); }
+    bool IndexEntities(uint32_t entityCount)
+    {
+        sparse.assign(entityCount, invalid);
+        for (size_t i = 0; i < entities.size(); i++)
+        {
+            if (entities[i] >= entityCount || sparse[entities[i]] != invalid) return false;
+            sparse[entities[i]] = static_cast<uint32_t>(i);
+        }
+        return true;
+    }
+
+    void Clear() { dense.clear(); entities.clear(); sparse.clear(); }
+};
\ No newline at end of file
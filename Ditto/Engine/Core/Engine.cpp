@@ -1,4 +1,8 @@
 #include "Engine.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
 #include <iostream>
 #include <stdexcept>
 #include "../../Editor/Editor.h"
@@ -10,12 +14,25 @@
 using namespace std;
 using namespace glm;
 
-Engine::Engine()
+static const string shaderDirectory = "../../Ditto/Ditto/Assets/Shaders";
+
+Engine::Engine(bool _headless)
 {
-    enableMouse = false;
+    headless = _headless; enableMouse = false;
+    window = nullptr; editor = nullptr; shader = nullptr; shaderWatcher = nullptr;
     window_width = 1200; window_height = 900;
     keySpeed = 0.01f, mouseSpeed = 1.0f;
 
+    jobs = new JobSystem();
+    resource = new Resource(!headless);
+    scene = new Scene();
+    scene->SetResource(resource);
+    scene->jobs = jobs;
+    physics = new Physics();
+    physics->jobs = jobs;
+    camera = new Camera(vec3(0, 10, 10), vec3(0, 0, 0), vec3(0, 1, 0));
+    if (headless) return;
+
     if (!glfwInit()) throw runtime_error("GLFW init failed");
 
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
@@ -30,39 +47,60 @@ Engine::Engine()
 
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) throw runtime_error("Failed to initialize GLAD");
 
-    resource = new Resource();
-    scene = new Scene();
-    camera = new Camera(vec3(0, 10, 10), vec3(0, 0, 0), vec3(0, 1, 0));
-    shader = new Shader("../../Ditto/Ditto/Assets/Shaders/Vertex.glsl", "../../Ditto/Ditto/Assets/Shaders/Fragment.glsl");
+    Shader::EnableParallelCompile((GLADloadproc)glfwGetProcAddress);
+    shader = new Shader((shaderDirectory + "/Vertex.glsl").c_str(), (shaderDirectory + "/Fragment.glsl").c_str());
+    if (!shader->id) throw runtime_error("Failed to build shaders");
+    shaderWatcher = new DirectoryWatcher(shaderDirectory);
+    if (shader->BlockSize("Frame") != sizeof(FrameUniforms))
+        cerr << "Shader Frame block is " << shader->BlockSize("Frame") << " bytes, FrameUniforms is " << sizeof(FrameUniforms) << endl;
     editor = new Editor(window);
     editor->engine = this;
-
-    scene->InitializeBaseGeometries(resource);
 }
 
 Engine::~Engine()
 {
     delete editor;
+    delete shaderWatcher;
     delete shader;
     delete camera;
+    delete physics;
     delete scene;
     delete resource;
+    delete jobs;
+    if (headless) return;
     if (window) glfwDestroyWindow(window);
     glfwTerminate();
 }
 
 void Engine::Run()
 {
+    float accumulator = 0;
+    double lastTime = glfwGetTime();
+    State lastState = state;
     while (state != Exit && !glfwWindowShouldClose(window))
     {
         ProcessInput();
         glfwPollEvents();
 
+        double now = glfwGetTime();
+        float frameTime = static_cast<float>(now - lastTime); lastTime = now;
+        if (state == Play)
+        {
+            if (lastState != Play) physics->collidersDirty = true, accumulator = 0;
+            accumulator = std::min(accumulator + frameTime, maxSubSteps * dt);
+            while (accumulator >= dt) { Simulate(); accumulator -= dt; }
+        }
+        lastState = state;
+
+        // Meshes finished by the loader thread are installed and uploaded a slice at a time
+        resource->ProcessUploads();
+
         glfwGetFramebufferSize(window, &window_width, &window_height);
         glViewport(0, 0, window_width, window_height);
         glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+        ReloadShaders();
         RenderScene();
         editor->Draw();
 
@@ -70,6 +108,82 @@ void Engine::Run()
     }
 }
 
+bool Engine::RunHeadless(const string& scenePath, int frameCount)
+{
+    if (!scene->LoadScene(scenePath)) return false;
+    StartSimulation();
+    auto start = chrono::steady_clock::now();
+    for (int frame = 0; frame < frameCount && state != Exit; frame++) Simulate();
+    double elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    cout << "Simulated " << frameCount << " frames of " << scene->gameObjects.size() << " objects in " << elapsed << " ms ("
+        << (frameCount > 0 ? elapsed / frameCount : 0.0) << " ms/frame, dt = " << dt << " s)" << endl;
+    return true;
+}
+
+void Engine::StartSimulation()
+{
+    // Nothing pumps uploads between headless steps: request every renderer's mesh and wait for all of them, so the
+    // colliders are built against the real shapes from the first step
+    for (RendererComponent& renderer : scene->components.Pool<RendererComponent>().dense) resource->Resolve(renderer.mesh, renderer.meshHandle);
+    resource->Flush();
+    state = Play; physics->collidersDirty = true;
+}
+
+bool Engine::CheckStacking(int bodyCount)
+{
+    if (bodyCount < 2) { cerr << "Stacking needs at least two bodies" << endl; return false; }
+
+    // Two layers of turned cubes and spheres, close enough that neighbours touch and the upper one lands on edges and corners
+    scene->ClearScene();
+    scene->name = "Stacking";
+    int side = static_cast<int>(std::ceil(std::sqrt((bodyCount + 1) / 2)));
+    for (int i = 0; i < bodyCount; i++)
+    {
+        int layer = i % 2, column = i / 2;
+        GameObject* body = scene->CreateGameObject("Body " + to_string(i));
+        body->AddComponent<RendererComponent>(i % 3 == 0 ? Resource::spherePath : Resource::cubePath);
+        body->AddComponent<RigidbodyComponent>();
+        TransformComponent* transform = body->GetComponent<TransformComponent>();
+        transform->position[0] = (column % side - side * 0.5f) * 1.3f + layer * 0.13f;
+        transform->position[1] = 0.5f + layer * 1.05f;
+        transform->position[2] = (column / side - side * 0.5f) * 1.3f;
+        transform->SetEulerAngles(vec3(float(i % 17), float(i * 7 % 90), float(i % 11)));
+        transform->UpdateTransform();
+    }
+    StartSimulation();
+
+    // The bodies touch within a few steps, four seconds keep them in resting contact well past that
+    const int frameCount = 240; const double stepBudget = 1000.0;
+    int firstContact = -1;
+    for (int frame = 0; frame < frameCount; frame++)
+    {
+        auto start = chrono::steady_clock::now();
+        Simulate();
+        double elapsed = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        if (elapsed > stepBudget) { cerr << "Stacking: step " << frame << " took " << elapsed << " ms" << endl; return false; }
+        if (firstContact < 0 && !physics->contacts.empty()) firstContact = frame;
+    }
+    if (firstContact < 0) { cerr << "Stacking: the layers never touched" << endl; return false; }
+
+    for (const TransformComponent& transform : scene->components.Pool<TransformComponent>().dense)
+    {
+        if (std::isfinite(transform.position[1]) && transform.position[1] > 0.25f) continue;
+        cerr << "Stacking: " << transform.gameObject->name << " sank to " << transform.position[1] << endl;
+        return false;
+    }
+    cout << "Stacked " << bodyCount << " bodies, first contact at step " << firstContact << ", " << physics->contacts.size()
+        << " contacts after " << frameCount << " steps" << endl;
+    return true;
+}
+
+void Engine::Simulate()
+{
+    scene->UpdateHierarchy(); // Colliders under a parent that moved last step follow it first
+    if (physics->CollidersStale(scene->components, resource)) physics->GenerateColliders(scene->components, resource);
+    physics->UpdatePhysics();
+}
+
 void Engine::RenderScene()
 {
     glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
@@ -84,6 +198,21 @@ void Engine::RenderScene()
     scene->Render(shader, view, projection, camera->position, window_width, window_height);
 }
 
+void Engine::ReloadShaders()
+{
+    // The current program keeps drawing while the rebuild compiles, a rebuild with errors never replaces it
+    for (const string& path : shaderWatcher->Poll())
+    {
+        error_code error;
+        if (filesystem::equivalent(path, shader->vertexPath, error) || filesystem::equivalent(path, shader->fragmentPath, error))
+        {
+            shader->Reload();
+            break;
+        }
+    }
+    if (shader->Update()) cout << "Reloaded " << shader->vertexPath << " and " << shader->fragmentPath << endl;
+}
+
 void Engine::ProcessInput()
 {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) state = Exit;
@@ -6,15 +6,18 @@
 #include "../../Engine/Graphics/Camera.h"
 #include "../../Engine/Physics/Physics.h"
 #include "../../Engine/Resources/Resource.h"
+#include "../../Engine/Resources/DirectoryWatcher.h"
 #include "../../3rdParty/GLFW/glfw3.h"
 #include "../../3rdParty/ImGui/imgui.h"
 
 struct Engine
 {
     enum State { Edit, Play, Stop, Exit } state = Edit;
+    bool headless;
 
     GLFWwindow* window;
     int window_width, window_height;
+    JobSystem* jobs;
     Resource* resource;
     Scene* scene;
     Editor* editor;
@@ -23,15 +26,21 @@ struct Engine
     float keySpeed, mouseSpeed;
     double lastX, lastY;
     Shader* shader;
+    DirectoryWatcher* shaderWatcher; // Saves in the shader folder rebuild the program while the editor runs
 	Physics* physics;
 
-    Engine();
+    Engine(bool _headless = false);
     ~Engine();
     Engine(const Engine&) = delete;
     Engine& operator=(const Engine&) = delete;
 
     void Run();
+    bool RunHeadless(const std::string& scenePath, int frameCount);
+    bool CheckStacking(int bodyCount); // Regression for resting contact, see Main.cpp
+    void StartSimulation(); // Headless: loads every renderer's mesh and enters Play
+    void Simulate();
     void ProcessInput();
     void RenderScene();
+    void ReloadShaders();
     static void MouseCallBack(GLFWwindow* window, double xpos, double ypos);
 };
\ No newline at end of file
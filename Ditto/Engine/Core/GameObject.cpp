@@ -1,6 +1,8 @@
+#define GLM_ENABLE_EXPERIMENTAL
 #include "GameObject.h"
 #include "../../3rdParty/ImGui/imgui.h"
 #include "../../3rdParty/GLM/ext/matrix_transform.hpp"
+#include "../../3rdParty/GLM/gtx/euler_angles.hpp"
 #include <algorithm>
 #include <fstream>
 
@@ -21,60 +23,112 @@ static std::string ReadString(std::ifstream& file)
     return str;
 }
 
-GameObject::GameObject(const std::string name)
+uint32_t ComponentStore::CreateEntity()
 {
+    if (freeEntities.empty()) return entityCount++;
+    uint32_t entity = freeEntities.back(); freeEntities.pop_back();
+    return entity;
+}
+
+void ComponentStore::DestroyEntity(uint32_t entity)
+{
+    ForEachPool([&](auto& pool) { pool.Remove(entity); });
+    freeEntities.push_back(entity); version++;
+}
+
+void ComponentStore::MarkDirty(uint32_t entity, int mask)
+{
+    if (entity >= modifiedMasks.size()) { dirtyFlags.resize(entity + 1, 0); modifiedMasks.resize(entity + 1, 0); movedFlags.resize(entity + 1, 0); }
+    if (!modifiedMasks[entity]) modifiedEntities.push_back(entity);
+    modifiedMasks[entity] |= static_cast<uint8_t>(mask);
+    if (mask & TransformComponent::Mask) movedFlags[entity] = 1;
+    if (dirtyFlags[entity]) return;
+    dirtyFlags[entity] = 1; dirtyEntities.push_back(entity);
+}
+
+void ComponentStore::MarkRenderDirty(uint32_t entity)
+{
+    if (entity >= modifiedMasks.size()) { dirtyFlags.resize(entity + 1, 0); modifiedMasks.resize(entity + 1, 0); movedFlags.resize(entity + 1, 0); }
+    if (dirtyFlags[entity]) return;
+    dirtyFlags[entity] = 1; dirtyEntities.push_back(entity);
+}
+
+void ComponentStore::ClearDirty()
+{
+    for (uint32_t entity : dirtyEntities) dirtyFlags[entity] = 0;
+    dirtyEntities.clear();
+}
+
+void ComponentStore::ClearModified()
+{
+    for (uint32_t entity : modifiedEntities) modifiedMasks[entity] = 0;
+    modifiedEntities.clear();
+}
+
+void ComponentStore::Clear()
+{
+    ForEachPool([](auto& pool) { pool.Clear(); });
+    freeEntities.clear(); entityCount = 0; version++;
+    dirtyEntities.clear(); dirtyFlags.clear();
+    modifiedEntities.clear(); modifiedMasks.clear(); movedFlags.clear();
+}
+
+GameObject::GameObject(ComponentStore* _store, const std::string name)
+{
+    store = _store; id = store->CreateEntity();
 	this->name = name;
 	this->AddComponent<TransformComponent>();
 }
 
+GameObject::GameObject(ComponentStore* _store, uint32_t _id, const std::string& _name)
+{
+    store = _store; id = _id; name = _name;
+}
+
 GameObject::GameObject(GameObject* other)
 {
+    store = other->store; id = store->CreateEntity();
     this->name = other->name;
-    for(auto i:other->components)
-    {
-        if (auto transform = dynamic_cast<TransformComponent*>(i))
-            this->AddComponent<TransformComponent>(transform);
-        else if (auto light = dynamic_cast<LightComponent*>(i))
-            this->AddComponent<LightComponent>(light);
-        else if (auto renderer = dynamic_cast<RendererComponent*>(i))
-            this->AddComponent<RendererComponent>(renderer);
-        else if (auto rigidbody = dynamic_cast<RigidbodyComponent*>(i))
-            this->AddComponent<RigidbodyComponent>(rigidbody);
-	}
+    // Copy out first, adding to a pool may reallocate the source component
+    if (auto transform = other->GetComponent<TransformComponent>()) { TransformComponent source = *transform; this->AddComponent<TransformComponent>(&source); }
+    if (auto light = other->GetComponent<LightComponent>()) { LightComponent source = *light; this->AddComponent<LightComponent>(&source); }
+    if (auto renderer = other->GetComponent<RendererComponent>()) { RendererComponent source = *renderer; this->AddComponent<RendererComponent>(&source); }
+    if (auto rigidbody = other->GetComponent<RigidbodyComponent>()) { RigidbodyComponent source = *rigidbody; this->AddComponent<RigidbodyComponent>(&source); }
 }
 
 GameObject::~GameObject()
 {
-	for (Component* comp : components) delete comp;
+    store->DestroyEntity(id);
 }
 
 void GameObject::OnInspectorGUI()
 {
-    ImGui::Checkbox("##Enabled", &enabled);
+    if (ImGui::Checkbox("##Enabled", &enabled)) store->MarkDirty(id, ComponentStore::objectModified);
     ImGui::SameLine();
     char nameBuffer[256];
     strcpy_s(nameBuffer, name.c_str());
     ImGui::Text("Name"); ImGui::SameLine();
-    if (ImGui::InputText("##Name", nameBuffer, sizeof(nameBuffer))) name = nameBuffer;
+    if (ImGui::InputText("##Name", nameBuffer, sizeof(nameBuffer))) { name = nameBuffer; store->MarkDirty(id, ComponentStore::objectModified); }
 
     ImGui::Separator();
 
-    for (int i = 0; i < components.size(); i++)
+    store->ForEachPool([&](auto& pool)
     {
-        Component* comp = components[i];
+        auto comp = pool.Get(id);
+        if (!comp) return;
         ImGui::PushID(comp);
         comp->OnInspectorGUI();
         ImGui::PopID();
         ImGui::Separator();
-    }
+    });
 
     if (ImGui::Button("Add Component")) ImGui::OpenPopup("AddComponentPopup");
 
     if (ImGui::BeginPopup("AddComponentPopup"))
     {
-        if (!(compMask >> 1 & 1) && ImGui::MenuItem("DirLight")) AddComponent<LightComponent>();
-        if (!(compMask >> 2 & 1) && ImGui::MenuItem("Renderer")) AddComponent<RendererComponent>();
-        if (!(compMask >> 3 & 1) && ImGui::MenuItem("Rigidbody")) AddComponent<RigidbodyComponent>();
+        if (!HasComponent<LightComponent>() && ImGui::MenuItem("DirLight")) AddComponent<LightComponent>();
+        if (!HasComponent<RendererComponent>() && ImGui::MenuItem("Renderer")) AddComponent<RendererComponent>();
+        if (!HasComponent<RigidbodyComponent>() && ImGui::MenuItem("Rigidbody")) AddComponent<RigidbodyComponent>();
         ImGui::EndPopup();
     }
 }
@@ -87,17 +141,22 @@ void GameObject::Serialize(std::ofstream& file) const
 
     file.write(reinterpret_cast<const char*>(&compMask), sizeof(compMask));
 
-    uint32_t componentCount = static_cast<uint32_t>(components.size());
+    uint32_t componentCount = 0;
+    for (int mask = compMask; mask; mask &= mask - 1) componentCount++;
     file.write(reinterpret_cast<const char*>(&componentCount), sizeof(componentCount));
 
-    for (Component* comp : components)
+    store->ForEachPool([&](auto& pool)
     {
-        file.write(reinterpret_cast<const char*>(&comp->index), sizeof(comp->index));
+        auto comp = pool.Get(id);
+        if (!comp) return;
+
+        int index = std::remove_reference_t<decltype(*comp)>::Mask;
+        file.write(reinterpret_cast<const char*>(&index), sizeof(index));
 
         file.write(reinterpret_cast<const char*>(&comp->enabled), sizeof(comp->enabled));
 
         comp->Serialize(file);
-    }
+    });
 }
 
 void GameObject::Deserialize(std::ifstream& file)
@@ -106,13 +165,14 @@ void GameObject::Deserialize(std::ifstream& file)
 
     name = ReadString(file);
 
-    file.read(reinterpret_cast<char*>(&compMask), sizeof(compMask));
+    int savedMask = 0;
+    file.read(reinterpret_cast<char*>(&savedMask), sizeof(savedMask));
 
     uint32_t componentCount = 0;
     file.read(reinterpret_cast<char*>(&componentCount), sizeof(componentCount));
 
-    for (Component* comp : components) delete comp;
-    components.clear();
+    store->ForEachPool([&](auto& pool) { pool.Remove(id); });
+    compMask = 0; store->version++;
 
     for (uint32_t i = 0; i < componentCount; i++)
     {
@@ -122,58 +182,44 @@ void GameObject::Deserialize(std::ifstream& file)
         bool compEnabled = true;
         file.read(reinterpret_cast<char*>(&compEnabled), sizeof(compEnabled));
 
-        Component* newComp = nullptr;
-
         switch (index)
         {
-        case 1 << 0: newComp = new TransformComponent(); break;
-        case 1 << 1: newComp = new LightComponent(); break;
-        case 1 << 2: newComp = new RendererComponent(); break;
-        case 1 << 3: newComp = new RigidbodyComponent(); break;
+        case TransformComponent::Mask: { auto comp = AddComponent<TransformComponent>(); comp->enabled = compEnabled; comp->Deserialize(file); break; }
+        case LightComponent::Mask: { auto comp = AddComponent<LightComponent>(); comp->enabled = compEnabled; comp->Deserialize(file); break; }
+        case RendererComponent::Mask: { auto comp = AddComponent<RendererComponent>(); comp->enabled = compEnabled; comp->Deserialize(file); break; }
+        case RigidbodyComponent::Mask: { auto comp = AddComponent<RigidbodyComponent>(); comp->enabled = compEnabled; comp->Deserialize(file); break; }
         default: continue;
         }
-
-        if (newComp)
-        {
-            newComp->index = index; newComp->enabled = compEnabled;
-            newComp->gameObject = this; newComp->Deserialize(file);
-
-            components.push_back(newComp);
-        }
     }
 }
 
 TransformComponent::TransformComponent()
 {
-    index = 1 << 0;
     position[0] = position[1] = position[2] = 0;
-    rotation[0] = rotation[1] = rotation[2] = 0;
     scale[0] = scale[1] = scale[2] = 1;
 
 	lastPosition[0] = lastPosition[1] = lastPosition[2] = 0;
-	lastRotation[0] = lastRotation[1] = lastRotation[2] = 0;
 	lastScale[0] = lastScale[1] = lastScale[2] = 1;
 	UpdateTransform();
 }
 
 TransformComponent::TransformComponent(TransformComponent* other)
 {
-    index = 1 << 0;
     for (int i = 0; i < 3; i++)
     {
         position[i] = other->position[i];
-        rotation[i] = other->rotation[i];
         scale[i] = other->scale[i];
         lastPosition[i] = other->lastPosition[i];
-        lastRotation[i] = other->lastRotation[i];
         lastScale[i] = other->lastScale[i];
     }
+    rotation = other->rotation; euler = other->euler; eulerRotation = other->eulerRotation;
+    parent = other->parent;
 	UpdateTransform();
 }
 
 void TransformComponent::OnInspectorGUI() 
 {
-    ImGui::Checkbox("##Enabled", &enabled);
+    if (ImGui::Checkbox("##Enabled", &enabled)) gameObject->store->MarkDirty(gameObject->id, Mask);
     ImGui::SameLine();
     ImGui::TextUnformatted("Transform");
 
@@ -182,8 +228,10 @@ void TransformComponent::OnInspectorGUI()
     ImGui::Indent(20.0f);
     ImGui::Text("Position"); ImGui::SameLine();
     ImGui::DragFloat3("##Position", position, 0.1f);
+    if (eulerRotation != rotation) { euler = EulerAngles(); eulerRotation = rotation; }
+    glm::vec3 lastEuler = euler;
     ImGui::Text("Rotation"); ImGui::SameLine();
-    ImGui::DragFloat3("##Rotation", rotation, 0.1f);
+    ImGui::DragFloat3("##Rotation", &euler.x, 0.1f);
     ImGui::Text("Scale   "); ImGui::SameLine();
     ImGui::DragFloat3("##Scale", scale, 0.1f);
     ImGui::Unindent(20.0f);
@@ -193,72 +241,113 @@ void TransformComponent::OnInspectorGUI()
 	bool changed = false;
     for (int i = 0; i < 3; i++)
     {
-        changed |= (lastPosition[i] != position[i]) || (lastRotation[i] != rotation[i]) || (lastScale[i] != scale[i]);
-		lastPosition[i] = position[i]; lastRotation[i] = rotation[i]; lastScale[i] = scale[i];
+        changed |= (lastPosition[i] != position[i]) || (lastScale[i] != scale[i]);
+		lastPosition[i] = position[i]; lastScale[i] = scale[i];
     }
+    if (euler != lastEuler) { SetEulerAngles(euler); changed = true; }
     if (changed) UpdateTransform();
 }
 
 void TransformComponent::UpdateTransform()
 {
-    glm::mat4 translation = glm::translate(glm::mat4(1.0f), glm::vec3(position[0], position[1], position[2]));
+    ComputeModel();
+    if (gameObject) gameObject->store->MarkDirty(gameObject->id, Mask);
+}
+
+void TransformComponent::ComputeModel()
+{
+    model = LocalMatrix();
+    forward = Forward(model);
+}
 
-    glm::mat4 rotationMat = glm::mat4(1.0f);
-    rotationMat = glm::rotate(rotationMat, glm::radians(rotation[1]), glm::vec3(0.0f, 1.0f, 0.0f)); // Yaw
-    rotationMat = glm::rotate(rotationMat, glm::radians(rotation[0]), glm::vec3(1.0f, 0.0f, 0.0f)); // Pitch
-    rotationMat = glm::rotate(rotationMat, glm::radians(rotation[2]), glm::vec3(0.0f, 0.0f, 1.0f)); // Roll
+glm::vec3 TransformComponent::Forward(const glm::mat4& world)
+{
+    glm::vec3 axis = -glm::vec3(world[2]);
+    float length = glm::length(axis);
+    return length > 1e-12f ? axis / length : glm::vec3(0.0f, 0.0f, -1.0f);
+}
+
+glm::mat4 TransformComponent::LocalMatrix() const
+{
+    // Translation * rotation * scale written straight into the columns: the rotation basis scaled per axis
+    glm::mat3 basis = glm::mat3_cast(rotation);
+    glm::mat4 local;
+    local[0] = glm::vec4(basis[0] * scale[0], 0.0f);
+    local[1] = glm::vec4(basis[1] * scale[1], 0.0f);
+    local[2] = glm::vec4(basis[2] * scale[2], 0.0f);
+    local[3] = glm::vec4(position[0], position[1], position[2], 1.0f);
+    return local;
+}
 
-    glm::mat4 scaleMat = glm::scale(glm::mat4(1.0f), glm::vec3(scale[0], scale[1], scale[2]));
+glm::vec3 TransformComponent::EulerAngles() const
+{
+    float yaw, pitch, roll;
+    glm::extractEulerAngleYXZ(glm::mat4_cast(rotation), yaw, pitch, roll);
+    return glm::degrees(glm::vec3(pitch, yaw, roll));
+}
 
-    model = translation * rotationMat * scaleMat;
+void TransformComponent::SetEulerAngles(const glm::vec3& degrees)
+{
+    glm::vec3 radians = glm::radians(degrees);
+    rotation = glm::angleAxis(radians.y, glm::vec3(0.0f, 1.0f, 0.0f)) * glm::angleAxis(radians.x, glm::vec3(1.0f, 0.0f, 0.0f))
+        * glm::angleAxis(radians.z, glm::vec3(0.0f, 0.0f, 1.0f));
+    euler = degrees; eulerRotation = rotation;
+}
 
-    glm::mat3 rotationMatrix3 = glm::mat3(rotationMat);
-    forward = rotationMatrix3 * glm::vec3(0.0f, 0.0f, -1.0f);
+void TransformComponent::ResetEditorState()
+{
+    for (int i = 0; i < 3; i++) { lastPosition[i] = position[i]; lastScale[i] = scale[i]; }
+    euler = EulerAngles(); eulerRotation = rotation;
 }
 
 void TransformComponent::Serialize(std::ofstream& file) const
 {
+    glm::vec3 angles = eulerRotation == rotation ? euler : EulerAngles();
     file.write(reinterpret_cast<const char*>(position), sizeof(float) * 3);
-    file.write(reinterpret_cast<const char*>(rotation), sizeof(float) * 3);
+    file.write(reinterpret_cast<const char*>(&angles.x), sizeof(float) * 3);
     file.write(reinterpret_cast<const char*>(scale), sizeof(float) * 3);
 }
 
 void TransformComponent::Deserialize(std::ifstream& file)
 {
+    glm::vec3 angles;
     file.read(reinterpret_cast<char*>(position), sizeof(float) * 3);
-    file.read(reinterpret_cast<char*>(rotation), sizeof(float) * 3);
+    file.read(reinterpret_cast<char*>(&angles.x), sizeof(float) * 3);
     file.read(reinterpret_cast<char*>(scale), sizeof(float) * 3);
 
-    for (int i = 0; i < 3; i++) { lastPosition[i] = position[i]; lastRotation[i] = rotation[i]; lastScale[i] = scale[i]; }
+    SetEulerAngles(angles);
+    for (int i = 0; i < 3; i++) { lastPosition[i] = position[i]; lastScale[i] = scale[i]; }
 
     UpdateTransform();
 }
 
 LightComponent::LightComponent()
 {
-    index = 1 << 1; color[0] = 1.0f; color[1] = 1.0f; color[2] = 1.0f; intensity = 1.0f;
+    color[0] = 1.0f; color[1] = 1.0f; color[2] = 1.0f; intensity = 1.0f;
 }
 
 LightComponent::LightComponent(LightComponent* other)
 {
-    index = 1 << 1; for (int i = 0; i < 3; i++) color[i] = other->color[i]; intensity = other->intensity;
+    for (int i = 0; i < 3; i++) color[i] = other->color[i];
+    intensity = other->intensity;
 }
 
 void LightComponent::OnInspectorGUI()
 {
-    ImGui::Checkbox("##Enabled", &enabled);
+    bool changed = ImGui::Checkbox("##Enabled", &enabled);
     ImGui::SameLine();
     ImGui::TextUnformatted("Light");
     ImGui::SameLine(ImGui::GetWindowWidth() - 30);
-    if (ImGui::SmallButton("X")) { gameObject->RemoveComponent(this); return; }
+    if (ImGui::SmallButton("X")) { gameObject->RemoveComponent<LightComponent>(); return; }
     if (!enabled) ImGui::PushStyleVar(ImGuiStyleVar_Alpha, 0.5f);
     ImGui::Indent(20.0f);
     ImGui::Text("Color    "); ImGui::SameLine();
-    ImGui::ColorEdit3("##Color", color);
+    changed |= ImGui::ColorEdit3("##Color", color);
     ImGui::Text("Intensity"); ImGui::SameLine();
-    ImGui::DragFloat("##Intensity", &intensity, 0.1f, 0.0f, 100.0f);
+    changed |= ImGui::DragFloat("##Intensity", &intensity, 0.1f, 0.0f, 100.0f);
     ImGui::Unindent(20.0f);
     if (!enabled) ImGui::PopStyleVar();
+    if (changed) gameObject->store->MarkDirty(gameObject->id, Mask);
 }
 
 void LightComponent::Serialize(std::ofstream& file) const
@@ -273,76 +362,92 @@ void LightComponent::Deserialize(std::ifstream& file)
     file.read(reinterpret_cast<char*>(&intensity), sizeof(intensity));
 }
 
-RendererComponent::RendererComponent(Type _type) 
+RendererComponent::RendererComponent(const std::string& _mesh) 
 {
-    index = 1 << 2; type = _type; color[0] = 1.0f; color[1] = 1.0f; color[2] = 1.0f; color[3] = 1.0f;
+    mesh = _mesh; color[0] = 1.0f; color[1] = 1.0f; color[2] = 1.0f; color[3] = 1.0f;
 }
 
 RendererComponent::RendererComponent(RendererComponent* other)
 {
-    index = 1 << 2; type = other->type; for (int i = 0; i < 4; i++) color[i] = other->color[i];
+    mesh = other->mesh; meshHandle = other->meshHandle; for (int i = 0; i < 4; i++) color[i] = other->color[i];
 }
 
 void RendererComponent::OnInspectorGUI()
 {
-    ImGui::Checkbox("##Enabled", &enabled);
+    bool changed = ImGui::Checkbox("##Enabled", &enabled);
     ImGui::SameLine();
     ImGui::TextUnformatted("Renderer");
 
     ImGui::SameLine(ImGui::GetWindowWidth() - 30);
-    if (ImGui::SmallButton("X")) { gameObject->RemoveComponent(this); return; }
+    if (ImGui::SmallButton("X")) { gameObject->RemoveComponent<RendererComponent>(); return; }
     if (!enabled) ImGui::PushStyleVar(ImGuiStyleVar_Alpha, 0.5f);
 
     ImGui::Indent(20.0f);
-    const char* typeNames[] = { "Cube", "Sphere", "Plane"};
-    int currentType = static_cast<int>(type);
-    ImGui::Text("Type "); ImGui::SameLine();
-    if (ImGui::Combo("##Type", &currentType, typeNames, 3))
+    // Built-in shapes are one click away, anything else is typed as a path and loaded on demand
+    const char* presetNames[] = { "Cube", "Sphere", "Plane", "Custom" };
+    const char* presetPaths[] = { Resource::cubePath, Resource::spherePath, Resource::planePath };
+    int currentPreset = 3;
+    for (int i = 0; i < 3; i++) if (mesh == presetPaths[i]) currentPreset = i;
+    ImGui::Text("Mesh "); ImGui::SameLine();
+    if (ImGui::Combo("##Mesh", &currentPreset, presetNames, 4) && currentPreset < 3)
     {
-        type = static_cast<Type>(currentType);
+        mesh = presetPaths[currentPreset]; meshHandle = Resource::invalidMesh; changed = true;
+    }
+    char pathBuffer[256];
+    strcpy_s(pathBuffer, mesh.c_str());
+    ImGui::Text("Path "); ImGui::SameLine();
+    if (ImGui::InputText("##Path", pathBuffer, sizeof(pathBuffer), ImGuiInputTextFlags_EnterReturnsTrue))
+    {
+        mesh = pathBuffer; meshHandle = Resource::invalidMesh; changed = true;
     }
     ImGui::Text("Color"); ImGui::SameLine();
-    ImGui::ColorEdit4("##Color", color, ImGuiColorEditFlags_AlphaBar);
+    changed |= ImGui::ColorEdit4("##Color", color, ImGuiColorEditFlags_AlphaBar);
     ImGui::Unindent(20.0f);
 
     if (!enabled) ImGui::PopStyleVar();
+    if (changed) gameObject->store->MarkDirty(gameObject->id, Mask);
 }
 
 void RendererComponent::Serialize(std::ofstream& file) const
 {
-    int32_t typeInt = static_cast<int32_t>(type);
-    file.write(reinterpret_cast<const char*>(&typeInt), sizeof(typeInt));
+    // -1 marks a mesh path; scenes written before the registry store a built-in index 0-2 here instead
+    int32_t builtin = -1;
+    file.write(reinterpret_cast<const char*>(&builtin), sizeof(builtin));
+    WriteString(file, mesh);
     file.write(reinterpret_cast<const char*>(color), sizeof(float) * 4);
 }
 
 void RendererComponent::Deserialize(std::ifstream& file)
 {
-    int32_t typeInt = 0;
-    file.read(reinterpret_cast<char*>(&typeInt), sizeof(typeInt));
-    type = static_cast<Type>(typeInt);
+    int32_t builtin = 0;
+    file.read(reinterpret_cast<char*>(&builtin), sizeof(builtin));
+    const char* builtinPaths[] = { Resource::cubePath, Resource::spherePath, Resource::planePath };
+    if (builtin < 0) mesh = ReadString(file);
+    else mesh = builtinPaths[builtin < 3 ? builtin : 0];
+    meshHandle = Resource::invalidMesh;
     file.read(reinterpret_cast<char*>(color), sizeof(float) * 4);
 }
 
 RigidbodyComponent::RigidbodyComponent()
 {
-    index = 1 << 3; type = Dynamic; mass = 1.0f; useGravity = true; 
+    type = Dynamic; mass = 1.0f; useGravity = true; 
 	velocity = angularVelocity = glm::vec3(0); damp = angularDamp = 0.05f;
 }
 
 RigidbodyComponent::RigidbodyComponent(RigidbodyComponent* other)
 {
-    index = 1 << 3; type = other->type; mass = other->mass; useGravity = other->useGravity;
+    type = other->type; mass = other->mass; useGravity = other->useGravity;
     velocity = angularVelocity = glm::vec3(0); damp = angularDamp = 0.05f;
 }
 
 void RigidbodyComponent::OnInspectorGUI()
 {
-    ImGui::Checkbox("##Enabled", &enabled);
+    bool changed = ImGui::Checkbox("##Enabled", &enabled);
     ImGui::SameLine();
     ImGui::TextUnformatted("Rigidbody");
 
     ImGui::SameLine(ImGui::GetWindowWidth() - 30);
-    if (ImGui::SmallButton("X")) { gameObject->RemoveComponent(this); return; }
+    if (ImGui::SmallButton("X")) { gameObject->RemoveComponent<RigidbodyComponent>(); return; }
     if (!enabled) ImGui::PushStyleVar(ImGuiStyleVar_Alpha, 0.5f);
 
     ImGui::Indent(20.0f);
@@ -352,19 +457,19 @@ void RigidbodyComponent::OnInspectorGUI()
     ImGui::Text("Type"); ImGui::SameLine();
     if (ImGui::Combo("##Type", &currentType, typeNames, 2))
     {
-        type = static_cast<Type>(currentType);
+        type = static_cast<Type>(currentType); changed = true;
     }
 
     if (type == Dynamic)
     {
         ImGui::Text("Use Gravity"); ImGui::SameLine();
-        ImGui::Checkbox("##Use Gravity", &useGravity);
+        changed |= ImGui::Checkbox("##Use Gravity", &useGravity);
         ImGui::Text("Mass "); ImGui::SameLine();
-        ImGui::DragFloat("##Mass", &mass, 0.1f, 0.001f, 1000.0f);
+        changed |= ImGui::DragFloat("##Mass", &mass, 0.1f, 0.001f, 1000.0f);
         ImGui::Text("Damp "); ImGui::SameLine();
-        ImGui::DragFloat("##Damp", &damp, 0.1f, 0.0f, 1.0f);
+        changed |= ImGui::DragFloat("##Damp", &damp, 0.1f, 0.0f, 1.0f);
         ImGui::Text("ADamp"); ImGui::SameLine();
-        ImGui::DragFloat("##AngularDamp", &angularDamp, 0.1f, 0.0f, 1.0f);
+        changed |= ImGui::DragFloat("##AngularDamp", &angularDamp, 0.1f, 0.0f, 1.0f);
 
         ImGui::Text("Velocity "); ImGui::SameLine();
         ImGui::Text("X: %.3f", velocity.x); ImGui::SameLine();
@@ -380,6 +485,7 @@ void RigidbodyComponent::OnInspectorGUI()
     ImGui::Unindent(20.0f);
 
     if (!enabled) ImGui::PopStyleVar();
+    if (changed) gameObject->store->MarkDirty(gameObject->id, Mask);
 }
 
 void RigidbodyComponent::Serialize(std::ofstream& file) const
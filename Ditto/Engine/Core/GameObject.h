@@ -1,105 +1,167 @@
 #pragma once
 #include <string>
 #include <vector>
+#include <tuple>
+#include "ComponentStore.h"
+#include "../Resources/Resource.h"
 #include "../../3rdParty/GLM/glm.hpp"
+#include "../../3rdParty/GLM/gtc/quaternion.hpp"
 
 struct GameObject;
 struct Component
-{
-    bool enabled = true; int index;
-    GameObject* gameObject;
-
-    virtual void OnInspectorGUI() = 0;
-    virtual void Serialize(std::ofstream& file) const = 0;
-    virtual void Deserialize(std::ifstream& file) = 0;
-};
-template<typename T>
-concept DerivedFromComponent = std::derived_from<T, Component>;
-
-struct GameObject
 {
     bool enabled = true;
-    int compMask = 0;
-    std::string name;
-    std::vector<Component*> components;
-
-    GameObject(const std::string name = "New GameObject");
-    GameObject(GameObject* other);
-    ~GameObject();
-    void OnInspectorGUI();
-    void Serialize(std::ofstream& file) const;
-    void Deserialize(std::ifstream& file);
-
-    template<DerivedFromComponent T, typename... Args>
-    T* AddComponent(Args&&... args)
-    {
-        T* newComponent = new T(std::forward<Args>(args)...);
-        components.push_back(newComponent); compMask += newComponent->index;
-        return newComponent;
-    }
-    template<DerivedFromComponent T>
-    T* GetComponent()
-    {
-        for (Component* comp : components)
-        {
-            T* result = dynamic_cast<T*>(comp);
-            if (result != nullptr) return result;
-        }
-        return nullptr;
-    }
-    void RemoveComponent(Component* component)
-    {
-        for (auto it = components.begin(); it != components.end(); it++)
-        {
-            if (*it == component) { delete* it; components.erase(it); compMask -= component->index; break; }
-        }
-    }
+    GameObject* gameObject = nullptr;
 };
+// Every component type carries a compile-time TypeId: its bit in GameObject::compMask and its pool slot in ComponentStore
+template<typename T>
+concept DerivedFromComponent = std::derived_from<T, Component> && requires { { T::TypeId } -> std::convertible_to<int>; };
 
+// position, rotation and scale are relative to the parent. model and forward are in world space: ComputeModel
+// sets them from the local values, which is final for a root, and the scene's TransformHierarchy composes
+// children with their parent's world matrix before the frame reads them.
 struct TransformComponent : Component 
 {
-    float position[3], rotation[3], scale[3];
+    static constexpr int TypeId = 0, Mask = 1 << TypeId;
+    static constexpr uint32_t noParent = UINT32_MAX;
+    float position[3], scale[3];
+    glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f); // Euler angles are only the inspector's view of it
 	glm::vec3 forward; glm::mat4 model;
+    uint32_t parent = noParent; // Entity id of the parent transform, changed through Scene::SetParent
 
     TransformComponent();
     TransformComponent(TransformComponent* other);
 
-    void OnInspectorGUI() override;
+    void OnInspectorGUI();
     void UpdateTransform();
-    void Serialize(std::ofstream& file) const override;
-    void Deserialize(std::ifstream& file) override;
+    void ComputeModel(); // UpdateTransform without marking the entity dirty, safe to run on many transforms at once
+    glm::mat4 LocalMatrix() const;
+    static glm::vec3 Forward(const glm::mat4& world); // -Z axis of a world matrix, scale removed
+    glm::vec3 EulerAngles() const; // Degrees around X, Y and Z, applied yaw first, then pitch, then roll
+    void SetEulerAngles(const glm::vec3& degrees);
+    void ResetEditorState(); // After position, rotation or scale were set directly, so the inspector sees no edit
+    void Serialize(std::ofstream& file) const;
+    void Deserialize(std::ifstream& file);
 private:
-	float lastPosition[3], lastRotation[3], lastScale[3];
+	float lastPosition[3], lastScale[3];
+    // Angles shown in the inspector and the rotation they describe. They are kept as typed, so dragging through
+    // a pole does not snap, and only re-derived once something else, like physics, has turned the transform.
+    glm::vec3 euler = glm::vec3(0.0f); glm::quat eulerRotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
 };
 
 struct LightComponent : Component 
 {
+    static constexpr int TypeId = 1, Mask = 1 << TypeId;
     float color[3]; float intensity;
     LightComponent();
 	LightComponent(LightComponent* other);
-    void OnInspectorGUI() override;
-    void Serialize(std::ofstream& file) const override;
-    void Deserialize(std::ifstream& file) override;
+    void OnInspectorGUI();
+    void Serialize(std::ofstream& file) const;
+    void Deserialize(std::ifstream& file);
 };
 
 struct RendererComponent : Component 
 {
-    enum Type { Cube, Sphere, Plane }; Type type; float color[4];
-    RendererComponent(Type _type = Cube);
+    static constexpr int TypeId = 2, Mask = 1 << TypeId;
+    std::string mesh; float color[4];
+    MeshHandle meshHandle = Resource::invalidMesh; // Registry handle for mesh, resolved on first draw or collider build
+    RendererComponent(const std::string& _mesh = Resource::cubePath);
 	RendererComponent(RendererComponent* other);
-    void OnInspectorGUI() override;
-    void Serialize(std::ofstream& file) const override;
-    void Deserialize(std::ifstream& file) override;
+    void OnInspectorGUI();
+    void Serialize(std::ofstream& file) const;
+    void Deserialize(std::ifstream& file);
 };
 
 struct RigidbodyComponent : Component 
 {
+    static constexpr int TypeId = 3, Mask = 1 << TypeId;
     enum Type { Static, Dynamic}; Type type; float mass; bool useGravity;
 	glm::vec3 velocity, angularVelocity; float damp, angularDamp;
 
     RigidbodyComponent();
 	RigidbodyComponent(RigidbodyComponent* other);
-    void OnInspectorGUI() override;
-    void Serialize(std::ofstream& file) const override;
-    void Deserialize(std::ifstream& file) override;
+    void OnInspectorGUI();
+    void Serialize(std::ofstream& file) const;
+    void Deserialize(std::ifstream& file);
+};
+
+// Owns one typed pool per component kind, all keyed by the same entity ids
+struct ComponentStore
+{
+    std::tuple<ComponentPool<TransformComponent>, ComponentPool<LightComponent>,
+        ComponentPool<RendererComponent>, ComponentPool<RigidbodyComponent>> pools;
+    std::vector<uint32_t> freeEntities;
+    uint32_t entityCount = 0;
+    uint64_t version = 0; // Bumped on every add or remove, pointers into the pools are stale once it changes
+    std::vector<uint32_t> dirtyEntities; // Entities changed since the renderer last consumed them
+    std::vector<uint8_t> dirtyFlags;
+    // Entities changed since the scene was last saved or loaded, with a mask of what changed: component Mask bits
+    // plus objectModified for the object's own name and enabled flag
+    static constexpr int objectModified = 1 << 7;
+    std::vector<uint32_t> modifiedEntities;
+    std::vector<uint8_t> modifiedMasks;
+    std::vector<uint8_t> movedFlags; // Transform changed since the hierarchy last composed it, cleared by TransformHierarchy
+
+    template<DerivedFromComponent T>
+    ComponentPool<T>& Pool()
+    {
+        static_assert(std::is_same_v<typename std::tuple_element_t<T::TypeId, decltype(pools)>::Type, T>, "TypeId must match the pool order");
+        return std::get<T::TypeId>(pools);
+    }
+    static constexpr int poolCount = static_cast<int>(std::tuple_size_v<decltype(pools)>);
+
+    template<typename F>
+    void ForEachPool(F&& function) { std::apply([&](auto&... pool) { (function(pool), ...); }, pools); }
+
+    uint32_t CreateEntity();
+    void DestroyEntity(uint32_t entity);
+    void MarkDirty(uint32_t entity, int mask);
+    void MarkRenderDirty(uint32_t entity); // World matrix changed through a parent, nothing of the entity's own to save
+    void ClearDirty();
+    void ClearModified();
+    void Clear();
+};
+
+// Lightweight handle: the components themselves live in the scene's ComponentStore
+struct GameObject
+{
+    uint32_t id;
+    bool enabled = true;
+    int compMask = 0;
+    std::string name;
+    ComponentStore* store;
+
+    GameObject(ComponentStore* _store, const std::string name = "New GameObject");
+    GameObject(ComponentStore* _store, uint32_t _id, const std::string& _name); // Adopts an existing entity, adds no components
+    GameObject(GameObject* other);
+    ~GameObject();
+    void OnInspectorGUI();
+    void Serialize(std::ofstream& file) const;
+    void Deserialize(std::ifstream& file);
+
+    template<DerivedFromComponent T, typename... Args>
+    T* AddComponent(Args&&... args)
+    {
+        ComponentPool<T>& pool = store->Pool<T>();
+        if (compMask & T::Mask) return &pool.dense[pool.sparse[id]];
+        T* newComponent = pool.Add(id, std::forward<Args>(args)...);
+        newComponent->gameObject = this; compMask |= T::Mask; store->version++;
+        return newComponent;
+    }
+    template<DerivedFromComponent T>
+    bool HasComponent() const { return compMask & T::Mask; }
+    template<DerivedFromComponent T>
+    T* GetComponent() const
+    {
+        // The mask bit answers misses without touching the pool, hits are one indexed load through the sparse array
+        if (!(compMask & T::Mask)) return nullptr;
+        ComponentPool<T>& pool = store->Pool<T>();
+        return &pool.dense[pool.sparse[id]];
+    }
+    template<DerivedFromComponent T>
+    void RemoveComponent()
+    {
+        if (!(compMask & T::Mask)) return;
+        compMask &= ~T::Mask; store->Pool<T>().Remove(id); store->version++;
+    }
 };
\ No newline at end of file
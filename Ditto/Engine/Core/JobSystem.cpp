@@ -0,0 +1,120 @@
+#include "JobSystem.h"
+
+// Which system a thread works for and its deque there
+static thread_local const JobSystem* currentSystem = nullptr;
+static thread_local size_t currentIndex = 0;
+
+JobSystem::JobSystem(unsigned workerCount)
+{
+    for (unsigned i = 0; i <= workerCount; i++) queues.push_back(std::make_unique<Queue>());
+    for (unsigned i = 1; i <= workerCount; i++) workers.emplace_back(&JobSystem::WorkerLoop, this, static_cast<size_t>(i));
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) worker.join();
+}
+
+unsigned JobSystem::DefaultWorkerCount()
+{
+    // The thread that owns the frame takes part in every Wait, so it counts as one of the cores
+    unsigned cores = std::thread::hardware_concurrency();
+    return cores > 1 ? cores - 1 : 0;
+}
+
+JobSystem& JobSystem::Serial()
+{
+    static JobSystem serial(0);
+    return serial;
+}
+
+size_t JobSystem::ThreadIndex() const
+{
+    return currentSystem == this ? currentIndex : 0;
+}
+
+void JobSystem::Run(JobGroup& group, std::function<void()> job)
+{
+    group.pending++;
+    Push([this, &group, job = std::move(job)] { job(); Finish(group); });
+}
+
+void JobSystem::RunAfter(JobGroup& dependency, JobGroup& group, std::function<void()> job)
+{
+    group.pending++;
+    std::function<void()> wrapped = [this, &group, job = std::move(job)] { job(); Finish(group); };
+    {
+        std::lock_guard<std::mutex> lock(dependency.mutex);
+        if (dependency.pending.load() > 0) { dependency.continuations.push_back(std::move(wrapped)); return; }
+    }
+    Push(std::move(wrapped));
+}
+
+void JobSystem::Wait(JobGroup& group)
+{
+    size_t index = ThreadIndex();
+    while (group.pending.load() > 0)
+    {
+        if (!RunOne(index)) std::this_thread::yield();
+    }
+    // The last job decrements under the lock, taking it here guarantees that job is done touching the group
+    std::lock_guard<std::mutex> lock(group.mutex);
+}
+
+void JobSystem::Push(std::function<void()> job)
+{
+    Queue& queue = *queues[ThreadIndex()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(std::move(job));
+    }
+    queued++;
+    // Taking the sleep lock orders this push against a worker that just found nothing and is about to sleep
+    { std::lock_guard<std::mutex> lock(sleepMutex); }
+    wake.notify_one();
+}
+
+void JobSystem::Finish(JobGroup& group)
+{
+    std::vector<std::function<void()>> ready;
+    {
+        std::lock_guard<std::mutex> lock(group.mutex);
+        if (--group.pending == 0) ready.swap(group.continuations);
+    }
+    for (std::function<void()>& job : ready) Push(std::move(job));
+}
+
+bool JobSystem::RunOne(size_t index)
+{
+    std::function<void()> job;
+    // Own deque from the back, newest first while its data is still in cache, then the oldest job of another deque
+    for (size_t i = 0; i < queues.size() && !job; i++)
+    {
+        Queue& queue = *queues[(index + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.jobs.empty()) continue;
+        if (i == 0) { job = std::move(queue.jobs.back()); queue.jobs.pop_back(); }
+        else { job = std::move(queue.jobs.front()); queue.jobs.pop_front(); }
+    }
+    if (!job) return false;
+    queued--;
+    job();
+    return true;
+}
+
+void JobSystem::WorkerLoop(size_t index)
+{
+    currentSystem = this; currentIndex = index;
+    while (true)
+    {
+        if (RunOne(index)) continue;
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this] { return stopping || queued.load() > 0; });
+        if (stopping) return;
+    }
+}
\ No newline at end of file
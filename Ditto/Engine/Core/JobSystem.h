@@ -0,0 +1,79 @@
+#pragma once
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+
+// A set of jobs that can be waited on or depended on. pending counts unfinished jobs, continuations holds the
+// jobs queued with RunAfter until pending drops to zero. A group must outlive the jobs added to it.
+struct JobGroup
+{
+	std::atomic<int> pending = 0;
+	std::mutex mutex;
+	std::vector<std::function<void()>> continuations;
+
+	JobGroup() = default;
+	JobGroup(const JobGroup&) = delete;
+	JobGroup& operator=(const JobGroup&) = delete;
+	bool Done() const { return pending.load() == 0; }
+};
+
+// Work-stealing scheduler: every worker owns a deque, pushes and pops at its back and steals from the front of the
+// others when it runs dry. Threads that are not workers share the first deque. Wait executes jobs while it waits,
+// so the frame thread never idles a core and jobs may spawn and wait on nested work.
+struct JobSystem
+{
+	JobSystem(unsigned workerCount = DefaultWorkerCount());
+	~JobSystem();
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	static unsigned DefaultWorkerCount();
+	static JobSystem& Serial(); // No workers, jobs run inside Wait on the waiting thread
+
+	void Run(JobGroup& group, std::function<void()> job);
+	void RunAfter(JobGroup& dependency, JobGroup& group, std::function<void()> job);
+	void Wait(JobGroup& group);
+
+	// Splits [0, count) into ranges of grain items, function(begin, end) runs once per range
+	template<typename F>
+	void ParallelFor(JobGroup& group, size_t count, size_t grain, F function)
+	{
+		grain = std::max<size_t>(grain, 1);
+		for (size_t begin = 0; begin < count; begin += grain)
+		{
+			size_t end = std::min(count, begin + grain);
+			Run(group, [function, begin, end] { function(begin, end); });
+		}
+	}
+	template<typename F>
+	void ParallelFor(size_t count, size_t grain, F function)
+	{
+		if (count <= grain) { if (count) function(size_t(0), count); return; } // Not worth a round trip through the queues
+		JobGroup group;
+		ParallelFor(group, count, grain, std::move(function));
+		Wait(group);
+	}
+
+	size_t ThreadCount() const { return queues.size(); }
+	size_t ThreadIndex() const; // 1..workers on this system's workers, 0 everywhere else
+
+private:
+	struct Queue { std::mutex mutex; std::deque<std::function<void()>> jobs; };
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> workers;
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::atomic<int> queued = 0;
+	bool stopping = false;
+
+	void Push(std::function<void()> job);
+	void Finish(JobGroup& group);
+	bool RunOne(size_t index);
+	void WorkerLoop(size_t index);
+};
\ No newline at end of file
@@ -1,227 +1,474 @@
 #include "Scene.h"
 #include "../../Engine/Resources/Resource.h"
 #include "../../Engine/Graphics/Shader.h"
+#include "../../Engine/Resources/MappedFile.h"
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <atomic>
 
 Scene::Scene()
 {
     name = "Default";
 
-    GameObject* lightObj = new GameObject("DirLight");
+    GameObject* lightObj = CreateGameObject("DirLight");
     lightObj->AddComponent<LightComponent>();
-	lightObj->GetComponent<TransformComponent>()->rotation[0] = -120.0f;
+	lightObj->GetComponent<TransformComponent>()->SetEulerAngles(glm::vec3(-120.0f, 0.0f, 0.0f));
 	lightObj->GetComponent<TransformComponent>()->UpdateTransform();
-    gameObjects.push_back(lightObj);
 
-    GameObject* gameObject = new GameObject("Cube");
+    GameObject* gameObject = CreateGameObject("Cube");
     gameObject->AddComponent<RendererComponent>();
     gameObject->AddComponent<RigidbodyComponent>();
-    gameObjects.push_back(gameObject);
-
-    geometryBatches[RendererComponent::Cube] = new GeometryInstances(RendererComponent::Cube);
-    geometryBatches[RendererComponent::Sphere] = new GeometryInstances(RendererComponent::Sphere);
-    geometryBatches[RendererComponent::Plane] = new GeometryInstances(RendererComponent::Plane);
 }
 
 Scene::~Scene()
 {
     for (GameObject* obj : gameObjects) delete obj;
     for (auto& pair : geometryBatches) delete pair.second;
+    if (frameUBO) glDeleteBuffers(1, &frameUBO);
+}
 
-    for (auto& pair : baseGeometries) 
+void GeometryInstances::Set(uint32_t entity, const glm::mat4& model, const glm::vec4& color)
+{
+    if (entity >= slots.size()) slots.resize(entity + 1, invalid);
+    if (slots[entity] == invalid)
+    {
+        slots[entity] = static_cast<uint32_t>(instanceCount++);
+        entities.push_back(entity); modelMatrices.push_back(model); instanceColors.push_back(color);
+        centerX.push_back(0); centerY.push_back(0); centerZ.push_back(0); extentX.push_back(0); extentY.push_back(0); extentZ.push_back(0);
+        boundStale.push_back(0);
+    }
+    else
+    {
+        modelMatrices[slots[entity]] = model; instanceColors[slots[entity]] = color;
+    }
+    // The world bound is only needed by the next cull, which recomputes all stale slots at once
+    size_t slot = slots[entity];
+    if (!boundStale[slot])
     {
-        if (pair.second.VAO) glDeleteVertexArrays(1, &pair.second.VAO);
-        if (pair.second.VBO) glDeleteBuffers(1, &pair.second.VBO);
-        if (pair.second.EBO) glDeleteBuffers(1, &pair.second.EBO);
+        boundStale[slot] = 1;
+        if (staleBegin == staleEnd) { staleBegin = slot; staleEnd = slot + 1; }
+        else { staleBegin = std::min(staleBegin, slot); staleEnd = std::max(staleEnd, slot + 1); }
     }
+    MarkDirty(slot);
 }
 
-GeometryInstances::~GeometryInstances()
+void GeometryInstances::Remove(uint32_t entity)
 {
-    if (modelSSBO) glDeleteBuffers(1, &modelSSBO);
-    if (colorSSBO) glDeleteBuffers(1, &colorSSBO);
+    if (!Has(entity)) return;
+    uint32_t slot = slots[entity], last = static_cast<uint32_t>(instanceCount - 1);
+    if (slot != last)
+    {
+        modelMatrices[slot] = modelMatrices[last]; instanceColors[slot] = instanceColors[last];
+        entities[slot] = entities[last]; slots[entities[slot]] = slot;
+        centerX[slot] = centerX[last]; centerY[slot] = centerY[last]; centerZ[slot] = centerZ[last];
+        extentX[slot] = extentX[last]; extentY[slot] = extentY[last]; extentZ[slot] = extentZ[last];
+        boundStale[slot] = boundStale[last];
+        if (boundStale[slot]) { staleBegin = std::min(staleBegin, size_t(slot)); staleEnd = std::max(staleEnd, size_t(slot) + 1); }
+        MarkDirty(slot);
+    }
+    modelMatrices.pop_back(); instanceColors.pop_back(); entities.pop_back();
+    centerX.pop_back(); centerY.pop_back(); centerZ.pop_back(); extentX.pop_back(); extentY.pop_back(); extentZ.pop_back();
+    boundStale.pop_back();
+    slots[entity] = invalid; instanceCount--;
+    for (int i = 0; i < regionCount; i++)
+    {
+        dirtyEnd[i] = std::min(dirtyEnd[i], instanceCount);
+        if (dirtyBegin[i] >= dirtyEnd[i]) dirtyBegin[i] = dirtyEnd[i] = 0;
+    }
+    staleEnd = std::min(staleEnd, instanceCount);
+    if (staleBegin >= staleEnd) staleBegin = staleEnd = 0;
 }
 
-void Scene::CollectRenderData()
+void GeometryInstances::Clear()
 {
-    for (auto& pair : geometryBatches) 
-    {
-        pair.second->modelMatrices.clear(); pair.second->instanceColors.clear();
-        pair.second->instanceCount = 0; pair.second->dirty = true;
-    }
+    modelMatrices.clear(); instanceColors.clear(); entities.clear(); slots.clear();
+    centerX.clear(); centerY.clear(); centerZ.clear(); extentX.clear(); extentY.clear(); extentZ.clear();
+    boundStale.clear(); staleBegin = staleEnd = 0;
+    instanceCount = visibleCount = 0;
+    for (int i = 0; i < regionCount; i++) dirtyBegin[i] = dirtyEnd[i] = 0;
+}
 
-    mainLight = nullptr;
-    for (GameObject* obj : gameObjects) 
+void GeometryInstances::MarkDirty(size_t slot)
+{
+    // Every region holds its own copy, so a write is pending in all of them until each has been refreshed
+    for (int i = 0; i < regionCount; i++)
     {
-        if (!obj->enabled) continue;
-
-        LightComponent* light = obj->GetComponent<LightComponent>();
-        if (light && light->enabled) { mainLight = obj; break; }
+        if (dirtyBegin[i] == dirtyEnd[i]) { dirtyBegin[i] = slot; dirtyEnd[i] = slot + 1; continue; }
+        dirtyBegin[i] = std::min(dirtyBegin[i], slot); dirtyEnd[i] = std::max(dirtyEnd[i], slot + 1);
     }
+}
 
-    for (GameObject* obj : gameObjects) 
-    {
-        if (!obj->enabled) continue;
+void GeometryInstances::MarkAllDirty()
+{
+    for (int i = 0; i < regionCount; i++) { dirtyBegin[i] = 0; dirtyEnd[i] = instanceCount; }
+}
 
-        RendererComponent* renderer = obj->GetComponent<RendererComponent>();
-        TransformComponent* transform = obj->GetComponent<TransformComponent>();
+void GeometryInstances::UpdateBound(size_t slot)
+{
+    // Same transform of the local box as Collider::UpdateBound, kept as center and half extent for the plane test
+    const glm::mat4& model = modelMatrices[slot];
+    glm::vec3 center = (localBound.min + localBound.max) * 0.5f, extent = (localBound.max - localBound.min) * 0.5f;
+    glm::vec3 worldCenter = glm::vec3(model * glm::vec4(center, 1.0f)), worldExtent;
+    for (int i = 0; i < 3; i++)
+        worldExtent[i] = std::abs(model[0][i]) * extent.x + std::abs(model[1][i]) * extent.y + std::abs(model[2][i]) * extent.z;
+
+    centerX[slot] = worldCenter.x; centerY[slot] = worldCenter.y; centerZ[slot] = worldCenter.z;
+    extentX[slot] = worldExtent.x; extentY[slot] = worldExtent.y; extentZ[slot] = worldExtent.z;
+}
 
-        if (renderer && renderer->enabled && transform && transform->enabled) 
+void GeometryInstances::UpdateBounds(JobSystem& jobs)
+{
+    // Each slot is transformed once per cull however often it was set, ranges write disjoint slots
+    jobs.ParallelFor(staleEnd - staleBegin, 4096, [this](size_t begin, size_t end)
+    {
+        for (size_t slot = staleBegin + begin; slot < staleBegin + end; slot++)
         {
-            auto it = geometryBatches.find(renderer->type);
-            if (it != geometryBatches.end()) 
-            {
-                GeometryInstances* batch = it->second;
-
-                batch->modelMatrices.push_back(transform->model);
-                batch->instanceColors.push_back(glm::vec4(renderer->color[0], renderer->color[1], renderer->color[2], renderer->color[3]));
-                batch->instanceCount++;
-                batch->dirty = true;
-            }
+            if (!boundStale[slot]) continue;
+            UpdateBound(slot);
+            boundStale[slot] = 0;
         }
-    }
+    });
+    staleBegin = staleEnd = 0;
 }
 
-void Scene::UpdateSSBOs()
+void GeometryInstances::SetLocalBound(const AABB& bound)
 {
-    for (auto& pair : geometryBatches) 
-    {
-        GeometryInstances* batch = pair.second;
-
-        if (!batch->dirty || batch->instanceCount == 0) continue;
+    localBound = bound;
+    std::fill(boundStale.begin(), boundStale.end(), uint8_t(1));
+    staleBegin = 0; staleEnd = instanceCount;
+}
 
-        if (batch->modelSSBO == 0) glGenBuffers(1, &batch->modelSSBO);
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, batch->modelSSBO);
-        glBufferData(GL_SHADER_STORAGE_BUFFER, batch->instanceCount * sizeof(glm::mat4), batch->modelMatrices.data(), GL_DYNAMIC_DRAW);
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, batch->modelSSBO);
+void GeometryInstances::Cull(const glm::vec4 planes[6])
+{
+    visibleSlots.resize(instanceCount);
+    visibleCount = 0;
 
-        if (batch->colorSSBO == 0) glGenBuffers(1, &batch->colorSSBO);
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, batch->colorSSBO);
-        glBufferData(GL_SHADER_STORAGE_BUFFER, batch->instanceCount * sizeof(glm::vec4), batch->instanceColors.data(), GL_DYNAMIC_DRAW);
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, batch->colorSSBO);
+    // A box is outside when its center lies further behind some plane than its projected radius.
+    // The body is branch-free over plain float arrays so the compiler can vectorize the plane tests.
+    const float* cx = centerX.data(); const float* cy = centerY.data(); const float* cz = centerZ.data();
+    const float* ex = extentX.data(); const float* ey = extentY.data(); const float* ez = extentZ.data();
+    glm::vec4 absPlanes[6];
+    for (int p = 0; p < 6; p++) absPlanes[p] = glm::vec4(glm::abs(glm::vec3(planes[p])), planes[p].w);
 
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
-        batch->dirty = false;
+    for (size_t i = 0; i < instanceCount; i++)
+    {
+        bool inside = true;
+        for (int p = 0; p < 6; p++)
+        {
+            float distance = planes[p].x * cx[i] + planes[p].y * cy[i] + planes[p].z * cz[i] + planes[p].w;
+            float radius = absPlanes[p].x * ex[i] + absPlanes[p].y * ey[i] + absPlanes[p].z * ez[i];
+            inside &= distance + radius >= 0;
+        }
+        visibleSlots[visibleCount] = static_cast<uint32_t>(i);
+        visibleCount += inside;
     }
 }
 
-void Scene::Render(Shader* shader, const glm::mat4& view, const glm::mat4& projection,
-    const glm::vec3& viewPos, int viewportWidth, int viewportHeight)
+static void ExtractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6])
 {
-    CollectRenderData();
-    UpdateSSBOs();
-
-    glUseProgram(shader->id);
-	shader->SetUniformMat4("view", view);
-	shader->SetUniformMat4("projection", projection);
-	shader->SetUniformVec3("viewPos", viewPos);
-	shader->SetUniformVec3("lightCol", GetLightColor());
-	shader->SetUniformVec3("lightDir", GetLightDirection());
-	shader->SetUniform1f("lightIntensity", GetLightIntensity());
+    // Gribb-Hartmann: each clip plane is the fourth row of the matrix plus or minus one of the others
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++) rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    for (int i = 0; i < 3; i++) { planes[i * 2] = rows[3] + rows[i]; planes[i * 2 + 1] = rows[3] - rows[i]; }
+    for (int i = 0; i < 6; i++) planes[i] /= glm::length(glm::vec3(planes[i]));
+}
 
-    for (auto& pair : geometryBatches) 
-    {
-        GeometryInstances* batch = pair.second;
+static size_t AlignUp(size_t size, size_t alignment) { return (size + alignment - 1) / alignment * alignment; }
 
-        if (batch->instanceCount == 0) continue;
-        auto geoIt = baseGeometries.find(batch->type);
-        if (geoIt == baseGeometries.end()) continue;
+InstanceBuffers::~InstanceBuffers()
+{
+    Release();
+}
 
-        const BaseGeometry& geometry = geoIt->second;
+static GLuint CreateMappedBuffer(GLenum target, size_t size, char*& mapped)
+{
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(target, buffer);
+    glBufferStorage(target, size, nullptr, flags);
+    mapped = static_cast<char*>(glMapBufferRange(target, 0, size, flags));
+    glBindBuffer(target, 0);
+    return buffer;
+}
 
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, batch->modelSSBO);
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, batch->modelSSBO);
+bool InstanceBuffers::Reserve(size_t instances, size_t commands)
+{
+    if (instances <= capacity && commands <= commandCapacity) return false;
+    Release();
+    capacity = std::max(instances, capacity * 2);
+    commandCapacity = std::max(commands, commandCapacity * 2);
+
+    // Regions are bound with glBindBufferRange, so each must start on the SSBO offset alignment
+    GLint alignment = 256;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    modelRegionSize = AlignUp(capacity * sizeof(glm::mat4), alignment);
+    colorRegionSize = AlignUp(capacity * sizeof(glm::vec4), alignment);
+    visibleRegionSize = AlignUp(capacity * sizeof(uint32_t), alignment);
+    commandRegionSize = commandCapacity * sizeof(DrawElementsIndirectCommand);
+
+    modelSSBO = CreateMappedBuffer(GL_SHADER_STORAGE_BUFFER, modelRegionSize * regionCount, mappedModels);
+    colorSSBO = CreateMappedBuffer(GL_SHADER_STORAGE_BUFFER, colorRegionSize * regionCount, mappedColors);
+    visibleSSBO = CreateMappedBuffer(GL_SHADER_STORAGE_BUFFER, visibleRegionSize * regionCount, mappedVisible);
+    commandBuffer = CreateMappedBuffer(GL_DRAW_INDIRECT_BUFFER, commandRegionSize * regionCount, mappedCommands);
+    return true;
+}
 
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, batch->colorSSBO);
-        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, batch->colorSSBO);
-        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+void InstanceBuffers::Advance()
+{
+    region = (region + 1) % regionCount;
+    if (fences[region])
+    {
+        // Only blocks when the GPU is more than regionCount - 1 frames behind
+        while (glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED);
+        glDeleteSync(fences[region]); fences[region] = nullptr;
+    }
+}
 
-        glBindVertexArray(geometry.VAO);
+void InstanceBuffers::Bind() const
+{
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, modelSSBO, region * modelRegionSize, capacity * sizeof(glm::mat4));
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 1, colorSSBO, region * colorRegionSize, capacity * sizeof(glm::vec4));
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 2, visibleSSBO, region * visibleRegionSize, capacity * sizeof(uint32_t));
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+}
 
-        if (geometry.indexCount > 0)  glDrawElementsInstanced(GL_TRIANGLES, geometry.indexCount, GL_UNSIGNED_INT, 0, batch->instanceCount);
-        else glDrawArraysInstanced(GL_TRIANGLES, 0, geometry.vertexCount, batch->instanceCount);
+void InstanceBuffers::Fence()
+{
+    if (fences[region]) glDeleteSync(fences[region]);
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
 
-        glBindVertexArray(0);
-    }
+void InstanceBuffers::Release()
+{
+    for (int i = 0; i < regionCount; i++) if (fences[i]) { glDeleteSync(fences[i]); fences[i] = nullptr; }
+    // Deleting a buffer unmaps it, the driver keeps the storage alive until in-flight draws finish
+    if (modelSSBO) glDeleteBuffers(1, &modelSSBO);
+    if (colorSSBO) glDeleteBuffers(1, &colorSSBO);
+    if (visibleSSBO) glDeleteBuffers(1, &visibleSSBO);
+    if (commandBuffer) glDeleteBuffers(1, &commandBuffer);
+    modelSSBO = colorSSBO = visibleSSBO = commandBuffer = 0;
+    mappedModels = mappedColors = mappedVisible = mappedCommands = nullptr;
 }
 
-void Scene::InitializeBaseGeometries(Resource* resource)
+void GeometryInstances::Upload(InstanceBuffers& buffers)
 {
-    if (resource->cubeModel && !resource->cubeModel->vertexData.empty()) 
+    int region = buffers.region;
+    if (dirtyBegin[region] < dirtyEnd[region])
     {
-        BaseGeometry cubeGeo;
-
-        glGenVertexArrays(1, &cubeGeo.VAO);
-        glGenBuffers(1, &cubeGeo.VBO);
-
-        glBindVertexArray(cubeGeo.VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, cubeGeo.VBO);
+        size_t begin = instanceBase + dirtyBegin[region], count = dirtyEnd[region] - dirtyBegin[region];
+        memcpy(buffers.mappedModels + region * buffers.modelRegionSize + begin * sizeof(glm::mat4), modelMatrices.data() + dirtyBegin[region], count * sizeof(glm::mat4));
+        memcpy(buffers.mappedColors + region * buffers.colorRegionSize + begin * sizeof(glm::vec4), instanceColors.data() + dirtyBegin[region], count * sizeof(glm::vec4));
+    }
+    dirtyBegin[region] = dirtyEnd[region] = 0;
+}
 
-        glBufferData(GL_ARRAY_BUFFER, resource->cubeModel->vertexData.size() * sizeof(float), resource->cubeModel->vertexData.data(), GL_STATIC_DRAW);
+void GeometryInstances::UploadVisible(InstanceBuffers& buffers, size_t visibleBase) const
+{
+    // The visible list depends on the camera, it is rewritten every frame
+    uint32_t* visible = reinterpret_cast<uint32_t*>(buffers.mappedVisible + buffers.region * buffers.visibleRegionSize) + visibleBase;
+    uint32_t base = static_cast<uint32_t>(instanceBase);
+    for (size_t i = 0; i < visibleCount; i++) visible[i] = base + visibleSlots[i];
+}
 
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
+void Scene::UpdateInstances(const std::vector<uint32_t>& entityList)
+{
+    // Moving entities between batches and resolving meshes stay on this thread, only the batch an entity was in
+    // and the one it belongs to now are touched
+    ComponentPool<RendererComponent>& renderers = components.Pool<RendererComponent>();
+    ComponentPool<TransformComponent>& transforms = components.Pool<TransformComponent>();
+    std::vector<GeometryInstances*> batches;
+    for (uint32_t entity : entityList)
+    {
+        RendererComponent* renderer = renderers.Get(entity);
+        TransformComponent* transform = transforms.Get(entity);
+        bool visible = resource && renderer && transform && renderer->enabled && transform->enabled && renderer->gameObject->enabled;
+        MeshHandle mesh = visible ? resource->Resolve(renderer->mesh, renderer->meshHandle) : Resource::invalidMesh;
+
+        if (entity >= instanceMeshes.size()) instanceMeshes.resize(entity + 1, Resource::invalidMesh);
+        MeshHandle previous = instanceMeshes[entity];
+        if (previous != mesh && previous != Resource::invalidMesh) geometryBatches[previous]->Remove(entity);
+        if (mesh != Resource::invalidMesh)
+        {
+            GeometryInstances* batch = GetBatch(mesh);
+            if (batch->pending.empty()) batches.push_back(batch);
+            batch->pending.push_back(entity);
+        }
+        instanceMeshes[entity] = mesh;
+    }
 
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
+    // Writing the instances only touches the batch, so each batch is filled by its own job in the order its entities
+    // were queued. An entity queued here and moved on by a later entry of the list is skipped.
+    JobSystem& jobSystem = jobs ? *jobs : JobSystem::Serial();
+    jobSystem.ParallelFor(batches.size(), 1, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            GeometryInstances* batch = batches[i];
+            for (uint32_t entity : batch->pending)
+            {
+                if (instanceMeshes[entity] != batch->mesh) continue;
+                const RendererComponent* renderer = renderers.Get(entity);
+                batch->Set(entity, transforms.Get(entity)->model, glm::vec4(renderer->color[0], renderer->color[1], renderer->color[2], renderer->color[3]));
+            }
+            batch->pending.clear();
+        }
+    });
+}
 
-        cubeGeo.vertexCount = static_cast<uint32_t>(resource->cubeModel->vertexData.size() / 6);
-        baseGeometries[RendererComponent::Cube] = cubeGeo;
+void Scene::CollectRenderData()
+{
+    // Children pick up their parents' moves before their instances are written
+    UpdateHierarchy();
 
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
+    mainLight = nullptr;
+    for (LightComponent& light : components.Pool<LightComponent>().dense)
+    {
+        if (light.enabled && light.gameObject->enabled) { mainLight = light.gameObject; break; }
     }
 
-    if (resource->sphereModel && !resource->sphereModel->vertexData.empty())
+    // Batches created while their mesh was still loading cull against a unit box until it arrives
+    if (resource && meshVersion != resource->meshVersion)
     {
-        BaseGeometry sphereGeo;
-
-        glGenVertexArrays(1, &sphereGeo.VAO);
-        glGenBuffers(1, &sphereGeo.VBO);
+        for (auto& pair : geometryBatches)
+        {
+            GeometryInstances* batch = pair.second;
+            if (batch->meshBound || !resource->IsReady(batch->mesh)) continue;
+            const MeshData* meshData = resource->GetMeshData(batch->mesh);
+            if (!meshData->vertices.empty()) batch->SetLocalBound({ meshData->aabbMin, meshData->aabbMax });
+            batch->meshBound = true;
+        }
+        meshVersion = resource->meshVersion;
+    }
 
-        glBindVertexArray(sphereGeo.VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, sphereGeo.VBO);
+    // Adding or removing components invalidates every slot, rebuild from the renderer pool in dense order
+    if (renderVersion != components.version)
+    {
+        for (auto& pair : geometryBatches) pair.second->Clear();
+        instanceMeshes.assign(instanceMeshes.size(), Resource::invalidMesh);
+        UpdateInstances(components.Pool<RendererComponent>().entities);
+        components.ClearDirty();
+        renderVersion = components.version;
+        return;
+    }
 
-        glBufferData(GL_ARRAY_BUFFER, resource->sphereModel->vertexData.size() * sizeof(float), resource->sphereModel->vertexData.data(), GL_STATIC_DRAW);
+    // Otherwise only the entities touched since last frame are rewritten in place
+    UpdateInstances(components.dirtyEntities);
+    components.ClearDirty();
+}
 
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
+void Scene::CullInstances(const glm::mat4& viewProjection)
+{
+    glm::vec4 planes[6];
+    ExtractFrustumPlanes(viewProjection, planes);
+
+    // Batches are independent, each job brings its batch's bounds up to date and culls it
+    JobSystem& jobSystem = jobs ? *jobs : JobSystem::Serial();
+    std::vector<GeometryInstances*> batches;
+    batches.reserve(geometryBatches.size());
+    for (auto& pair : geometryBatches) batches.push_back(pair.second);
+    jobSystem.ParallelFor(batches.size(), 1, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            batches[i]->UpdateBounds(jobSystem);
+            batches[i]->Cull(planes);
+        }
+    });
+}
 
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
+void Scene::UpdateSSBOs()
+{
+    // A batch that outgrew its slots moves every batch: the ranges are laid out again with room to grow
+    bool relayout = false;
+    for (auto& pair : geometryBatches) relayout |= pair.second->instanceCount > pair.second->capacity;
+    size_t total = 0;
+    for (auto& pair : geometryBatches)
+    {
+        GeometryInstances* batch = pair.second;
+        if (relayout && batch->instanceCount > batch->capacity) batch->capacity = std::max(batch->instanceCount, batch->capacity * 2);
+        if (relayout) batch->instanceBase = total;
+        total += batch->capacity;
+    }
+    if (total == 0) { drawCount = 0; return; }
+    if (instances.Reserve(total, geometryBatches.size()) || relayout)
+        for (auto& pair : geometryBatches) pair.second->MarkAllDirty();
+    instances.Advance();
+
+    // Each drawable batch becomes one command whose instances start at its range of the visible list
+    DrawElementsIndirectCommand* commands = reinterpret_cast<DrawElementsIndirectCommand*>(instances.mappedCommands + instances.region * instances.commandRegionSize);
+    size_t visibleBase = 0;
+    drawCount = 0;
+    for (auto& pair : geometryBatches) 
+    {
+        GeometryInstances* batch = pair.second;
 
-        sphereGeo.vertexCount = static_cast<uint32_t>(resource->sphereModel->vertexData.size() / 6);
-        baseGeometries[RendererComponent::Sphere] = sphereGeo;
+        batch->Upload(instances);
+        if (batch->visibleCount == 0) continue;
+        const BaseGeometry* geometry = resource->GetGeometry(batch->mesh);
+        if (!geometry) continue; // Still streaming in
 
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
+        batch->UploadVisible(instances, visibleBase);
+        commands[drawCount++] = { geometry->indexCount, static_cast<uint32_t>(batch->visibleCount), geometry->firstIndex, geometry->baseVertex, static_cast<uint32_t>(visibleBase) };
+        visibleBase += batch->visibleCount;
     }
+}
 
-    if (resource->planeModel && !resource->planeModel->vertexData.empty())
-    {
-        BaseGeometry planeGeo;
-
-        glGenVertexArrays(1, &planeGeo.VAO);
-        glGenBuffers(1, &planeGeo.VBO);
+void Scene::Render(Shader* shader, const glm::mat4& view, const glm::mat4& projection,
+    const glm::vec3& viewPos, int viewportWidth, int viewportHeight)
+{
+    CollectRenderData();
+    CullInstances(projection * view);
+    UpdateSSBOs();
 
-        glBindVertexArray(planeGeo.VAO);
-        glBindBuffer(GL_ARRAY_BUFFER, planeGeo.VBO);
+    // Camera and light go out as one buffer update instead of a uniform call each
+    FrameUniforms frame = { view, projection, glm::vec4(viewPos, 1.0f), glm::vec4(GetLightColor(), GetLightIntensity()), glm::vec4(GetLightDirection(), 0.0f) };
+    if (!frameUBO)
+    {
+        glGenBuffers(1, &frameUBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr, GL_DYNAMIC_DRAW);
+    }
+    else glBindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &frame);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FrameUniforms::binding, frameUBO);
 
-        glBufferData(GL_ARRAY_BUFFER, resource->planeModel->vertexData.size() * sizeof(float), resource->planeModel->vertexData.data(), GL_STATIC_DRAW);
+    if (drawCount == 0) return;
+    glUseProgram(shader->id);
 
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
+    // Every mesh sits in the arena, so the whole scene is one draw with one set of bindings
+    instances.Bind();
+    glBindVertexArray(resource->arena.VAO);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(instances.region * instances.commandRegionSize), static_cast<GLsizei>(drawCount), 0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    instances.Fence();
+}
 
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(1);
+void Scene::SetResource(Resource* _resource)
+{
+    resource = _resource;
+    renderVersion = UINT64_MAX; meshVersion = 0;
+}
 
-        planeGeo.vertexCount = static_cast<uint32_t>(resource->planeModel->vertexData.size() / 6);
-        baseGeometries[RendererComponent::Plane] = planeGeo;
+GeometryInstances* Scene::GetBatch(MeshHandle mesh)
+{
+    auto it = geometryBatches.find(mesh);
+    if (it != geometryBatches.end()) return it->second;
 
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glBindVertexArray(0);
+    // Cull against the real mesh extents once the mesh has any
+    GeometryInstances* batch = new GeometryInstances(mesh);
+    if (resource->IsReady(mesh))
+    {
+        const MeshData* meshData = resource->GetMeshData(mesh);
+        if (!meshData->vertices.empty()) batch->localBound = { meshData->aabbMin, meshData->aabbMax };
+        batch->meshBound = true;
     }
+    geometryBatches.emplace(mesh, batch);
+    return batch;
 }
 
 glm::vec3 Scene::GetLightColor() const
@@ -259,18 +506,316 @@ struct SceneHeader
     char magic[4]; uint32_t version, gameObjectCount; uint64_t fileSize;
 };
 
-const uint32_t SCENE_VERSION = 1;
+// Version 3 body: a chunk count and table right after the header, then 16-byte aligned chunks. Component chunks
+// are columns: the owning object indices, then one fixed-layout record per component, decoded field by field
+// (stride guards against a record of another layout). Strings live in one shared blob.
+enum SceneChunkType : uint32_t { ChunkName, ChunkStrings, ChunkObjects, ChunkComponents };
+struct SceneChunk { uint32_t type, typeId, count, stride; uint64_t offset, size; };
+struct SceneObjectRecord { uint32_t nameOffset, nameLength; uint8_t enabled, padding[3]; };
+struct SceneTransformRecord { float position[3], rotation[4] /* x, y, z, w */, scale[3]; uint32_t parent; uint8_t enabled, padding[3]; };
+struct SceneLightRecord { float color[3], intensity; uint8_t enabled, padding[3]; };
+struct SceneRendererRecord { uint32_t meshOffset, meshLength; float color[4]; uint8_t enabled, padding[3]; };
+struct SceneRigidbodyRecord { uint32_t type; float mass, damp, angularDamp; uint8_t useGravity, enabled, padding[2]; };
+static_assert(sizeof(SceneTransformRecord) == 48 && sizeof(SceneLightRecord) == 20 && sizeof(SceneRigidbodyRecord) == 20,
+    "Scene records are a file format, their layout must not depend on the build");
+template<typename T> struct SceneRecordOf;
+template<> struct SceneRecordOf<TransformComponent> { using Type = SceneTransformRecord; };
+template<> struct SceneRecordOf<LightComponent> { using Type = SceneLightRecord; };
+template<> struct SceneRecordOf<RendererComponent> { using Type = SceneRendererRecord; };
+template<> struct SceneRecordOf<RigidbodyComponent> { using Type = SceneRigidbodyRecord; };
+
+// 2: renderers store a mesh path instead of a built-in shape index, 3: chunked columns of fixed-layout records
+const uint32_t SCENE_VERSION = 3;
 const char SCENE_MAGIC[4] = { 'S', 'C', 'N', '\0' };
 
+static size_t AlignChunk(size_t size) { return (size + 15) & ~size_t(15); }
+
+GameObject* Scene::CreateGameObject(const std::string& objectName)
+{
+    GameObject* gameObject = new GameObject(&components, objectName);
+    gameObjects.push_back(gameObject);
+    return gameObject;
+}
+
+void Scene::DestroyGameObject(GameObject* gameObject)
+{
+    for (TransformComponent& transform : components.Pool<TransformComponent>().dense)
+    {
+        if (transform.parent != gameObject->id) continue;
+        transform.parent = TransformComponent::noParent;
+        transform.UpdateTransform();
+    }
+    gameObjects.erase(std::remove(gameObjects.begin(), gameObjects.end(), gameObject), gameObjects.end());
+    if (mainLight == gameObject) mainLight = nullptr;
+    delete gameObject;
+}
+
+bool Scene::SetParent(GameObject* child, GameObject* parent)
+{
+    ComponentPool<TransformComponent>& transforms = components.Pool<TransformComponent>();
+    TransformComponent* transform = transforms.Get(child->id);
+    if (!transform || (parent && !transforms.Has(parent->id))) return false;
+
+    // The new parent must not be the child or one of its descendants, the walk is bounded in case a file holds a cycle
+    uint32_t parentId = parent ? parent->id : TransformComponent::noParent, ancestor = parentId;
+    for (uint32_t depth = 0; ancestor != TransformComponent::noParent && depth <= components.entityCount; depth++)
+    {
+        if (ancestor == child->id) return false;
+        const TransformComponent* above = transforms.Get(ancestor);
+        ancestor = above ? above->parent : TransformComponent::noParent;
+    }
+    if (transform->parent == parentId) return true;
+
+    // The local values are kept, so the child now moves relative to its new parent
+    transform->parent = parentId;
+    transform->UpdateTransform();
+    hierarchy.linksChanged = true;
+    return true;
+}
+
+void Scene::UpdateHierarchy()
+{
+    hierarchy.Update(components);
+}
+
 void Scene::ClearScene()
 {
     for (GameObject* obj : gameObjects) delete obj;
     gameObjects.clear();
+    components.Clear();
     mainLight = nullptr;
 }
 
+void Scene::ReplaceComponents(ComponentStore&& loaded)
+{
+    ClearScene();
+    // The version keeps counting up, so nothing cached against the old store mistakes the new one for it
+    uint64_t version = components.version;
+    components = std::move(loaded);
+    components.version = version + 1;
+}
+
+// Builds the chunk data in memory so the file is written with a handful of large writes
+struct SceneWriter
+{
+    std::vector<SceneChunk> chunks;
+    std::vector<char> data, strings;
+    std::unordered_map<std::string, uint32_t> stringOffsets;
+
+    uint32_t AddString(const std::string& str, bool deduplicate)
+    {
+        if (deduplicate)
+        {
+            auto it = stringOffsets.find(str);
+            if (it != stringOffsets.end()) return it->second;
+        }
+        uint32_t offset = static_cast<uint32_t>(strings.size());
+        strings.insert(strings.end(), str.begin(), str.end());
+        if (deduplicate) stringOffsets.emplace(str, offset);
+        return offset;
+    }
+
+    char* AddChunk(uint32_t type, uint32_t typeId, uint32_t count, uint32_t stride, size_t size)
+    {
+        size_t offset = AlignChunk(data.size());
+        data.resize(offset + size);
+        chunks.push_back({ type, typeId, count, stride, offset, size });
+        return data.data() + offset;
+    }
+
+    template<typename Record>
+    Record* AddComponentChunk(uint32_t typeId, const std::vector<uint32_t>& objects)
+    {
+        uint32_t count = static_cast<uint32_t>(objects.size());
+        size_t recordOffset = AlignChunk(count * sizeof(uint32_t));
+        char* chunk = AddChunk(ChunkComponents, typeId, count, sizeof(Record), recordOffset + count * sizeof(Record));
+        if (count) memcpy(chunk, objects.data(), count * sizeof(uint32_t));
+        return reinterpret_cast<Record*>(chunk + recordOffset);
+    }
+};
+
+std::vector<uint32_t> Scene::ObjectIndices() const
+{
+    // Entity ids can have holes, the file refers to objects by their index in gameObjects instead
+    std::vector<uint32_t> objectIndices(components.entityCount, UINT32_MAX);
+    for (size_t i = 0; i < gameObjects.size(); i++) objectIndices[gameObjects[i]->id] = static_cast<uint32_t>(i);
+    return objectIndices;
+}
+
+// Parents are entity ids in memory and object indices in the file, like component owners
+static uint32_t ParentIndex(uint32_t parent, const std::vector<uint32_t>& objectIndices)
+{
+    return parent < objectIndices.size() ? objectIndices[parent] : TransformComponent::noParent;
+}
+
+// Records never hold pointers or editor state, parents are object indices like component owners
+static SceneTransformRecord ToRecord(const TransformComponent& transform, const std::vector<uint32_t>& objectIndices)
+{
+    SceneTransformRecord record = {};
+    memcpy(record.position, transform.position, sizeof(record.position));
+    memcpy(record.scale, transform.scale, sizeof(record.scale));
+    record.rotation[0] = transform.rotation.x; record.rotation[1] = transform.rotation.y;
+    record.rotation[2] = transform.rotation.z; record.rotation[3] = transform.rotation.w;
+    record.parent = ParentIndex(transform.parent, objectIndices);
+    record.enabled = transform.enabled;
+    return record;
+}
+
+static SceneLightRecord ToRecord(const LightComponent& light, const std::vector<uint32_t>&)
+{
+    SceneLightRecord record = {};
+    memcpy(record.color, light.color, sizeof(record.color));
+    record.intensity = light.intensity; record.enabled = light.enabled;
+    return record;
+}
+
+static SceneRigidbodyRecord ToRecord(const RigidbodyComponent& rigidbody, const std::vector<uint32_t>&)
+{
+    SceneRigidbodyRecord record = {};
+    record.type = rigidbody.type; record.mass = rigidbody.mass; record.damp = rigidbody.damp; record.angularDamp = rigidbody.angularDamp;
+    record.useGravity = rigidbody.useGravity; record.enabled = rigidbody.enabled;
+    return record;
+}
+
+// What a record is checked against while decoding: the object count for parents, the string blob for paths
+struct SceneDecodeContext
+{
+    uint32_t objectCount; const char* strings; uint64_t stringSize;
+
+    bool String(uint32_t offset, uint32_t length, std::string& out) const
+    {
+        if (offset > stringSize || length > stringSize - offset) return false;
+        out.assign(strings + offset, length);
+        return true;
+    }
+};
+
+// Bool and enum bytes are checked before they reach a component, any other value would be undefined there
+static bool FromRecord(const SceneTransformRecord& record, TransformComponent& transform, const SceneDecodeContext& context)
+{
+    if (record.enabled > 1 || (record.parent != TransformComponent::noParent && record.parent >= context.objectCount)) return false;
+    memcpy(transform.position, record.position, sizeof(transform.position));
+    memcpy(transform.scale, record.scale, sizeof(transform.scale));
+    transform.rotation = glm::quat(record.rotation[3], record.rotation[0], record.rotation[1], record.rotation[2]);
+    transform.parent = record.parent; transform.enabled = record.enabled != 0;
+    transform.ComputeModel();
+    transform.ResetEditorState();
+    return true;
+}
+
+static bool FromRecord(const SceneLightRecord& record, LightComponent& light, const SceneDecodeContext&)
+{
+    if (record.enabled > 1) return false;
+    memcpy(light.color, record.color, sizeof(light.color));
+    light.intensity = record.intensity; light.enabled = record.enabled != 0;
+    return true;
+}
+
+static bool FromRecord(const SceneRendererRecord& record, RendererComponent& renderer, const SceneDecodeContext& context)
+{
+    if (record.enabled > 1 || !context.String(record.meshOffset, record.meshLength, renderer.mesh)) return false;
+    memcpy(renderer.color, record.color, sizeof(renderer.color));
+    renderer.enabled = record.enabled != 0;
+    return true;
+}
+
+static bool FromRecord(const SceneRigidbodyRecord& record, RigidbodyComponent& rigidbody, const SceneDecodeContext&)
+{
+    if (record.enabled > 1 || record.useGravity > 1 || record.type > RigidbodyComponent::Dynamic) return false;
+    rigidbody.type = static_cast<RigidbodyComponent::Type>(record.type);
+    rigidbody.mass = record.mass; rigidbody.damp = record.damp; rigidbody.angularDamp = record.angularDamp;
+    rigidbody.useGravity = record.useGravity != 0; rigidbody.enabled = record.enabled != 0;
+    // Velocities are runtime state and start at rest, as they did with the per-field format
+    rigidbody.velocity = rigidbody.angularVelocity = glm::vec3(0);
+    return true;
+}
+
+// Decodes records [begin, end) of a component chunk into the same slice of a pool sized by Resize
+template<typename T>
+static bool DecodeRange(const char* chunkData, uint32_t count, size_t begin, size_t end, const SceneDecodeContext& context, ComponentPool<T>& pool)
+{
+    using Record = typename SceneRecordOf<T>::Type;
+    memcpy(pool.entities.data() + begin, chunkData + begin * sizeof(uint32_t), (end - begin) * sizeof(uint32_t));
+    const char* records = chunkData + AlignChunk(size_t(count) * sizeof(uint32_t));
+    for (size_t i = begin; i < end; i++)
+    {
+        Record record;
+        memcpy(&record, records + i * sizeof(Record), sizeof(Record));
+        if (!FromRecord(record, pool.dense[i], context)) return false;
+    }
+    return true;
+}
+
+// Remembers where the records of a chunked file live, for PatchScene
+static void RememberLayout(Scene& scene, const std::string& path, const std::vector<SceneChunk>& chunks, uint64_t fileSize)
+{
+    scene.savedPath = path; scene.savedVersion = scene.components.version; scene.savedFileSize = fileSize;
+    for (uint64_t& offset : scene.savedComponentOffsets) offset = UINT64_MAX;
+    for (const SceneChunk& chunk : chunks)
+    {
+        if (chunk.type == ChunkObjects) scene.savedObjectOffset = chunk.offset;
+        else if (chunk.type == ChunkStrings) { scene.savedStringOffset = chunk.offset; scene.savedStringSize = chunk.size; }
+        else if (chunk.type == ChunkComponents && chunk.typeId < ComponentStore::poolCount)
+            scene.savedComponentOffsets[chunk.typeId] = chunk.offset + AlignChunk(size_t(chunk.count) * sizeof(uint32_t));
+    }
+    scene.components.ClearModified();
+}
+
 bool Scene::SaveScene(const std::string& filepath)
 {
+    if (filepath == savedPath && savedVersion == components.version && PatchScene()) return true;
+
+    std::vector<uint32_t> objectIndices = ObjectIndices();
+
+    SceneWriter writer;
+    memcpy(writer.AddChunk(ChunkName, 0, 0, 1, name.size()), name.data(), name.size());
+
+    SceneObjectRecord* objects = reinterpret_cast<SceneObjectRecord*>(writer.AddChunk(ChunkObjects, 0,
+        static_cast<uint32_t>(gameObjects.size()), sizeof(SceneObjectRecord), gameObjects.size() * sizeof(SceneObjectRecord)));
+    for (size_t i = 0; i < gameObjects.size(); i++)
+    {
+        const GameObject* obj = gameObjects[i];
+        objects[i] = { writer.AddString(obj->name, false), static_cast<uint32_t>(obj->name.size()), obj->enabled, {} };
+    }
+
+    components.ForEachPool([&](auto& pool)
+    {
+        using T = typename std::remove_reference_t<decltype(pool)>::Type;
+        std::vector<uint32_t> owners(pool.Size());
+        for (size_t i = 0; i < pool.Size(); i++) owners[i] = objectIndices[pool.entities[i]];
+
+        if constexpr (!std::is_same_v<T, RendererComponent>)
+        {
+            using Record = typename SceneRecordOf<T>::Type;
+            Record* records = writer.AddComponentChunk<Record>(T::TypeId, owners);
+            for (size_t i = 0; i < pool.Size(); i++) records[i] = ToRecord(pool.dense[i], objectIndices);
+        }
+        else
+        {
+            // Mesh paths go to the string blob, shared between renderers
+            SceneRendererRecord* records = writer.AddComponentChunk<SceneRendererRecord>(T::TypeId, owners);
+            for (size_t i = 0; i < pool.Size(); i++)
+            {
+                const RendererComponent& renderer = pool.dense[i];
+                records[i] = { writer.AddString(renderer.mesh, true), static_cast<uint32_t>(renderer.mesh.size()), {}, renderer.enabled, {} };
+                memcpy(records[i].color, renderer.color, sizeof(records[i].color));
+            }
+        }
+    });
+
+    memcpy(writer.AddChunk(ChunkStrings, 0, 0, 1, writer.strings.size()), writer.strings.data(), writer.strings.size());
+
+    uint32_t chunkCount = static_cast<uint32_t>(writer.chunks.size());
+    size_t dataStart = AlignChunk(sizeof(SceneHeader) + sizeof(chunkCount) + chunkCount * sizeof(SceneChunk));
+    for (SceneChunk& chunk : writer.chunks) chunk.offset += dataStart;
+
+    SceneHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SCENE_MAGIC, 4);
+    header.version = SCENE_VERSION;
+    header.gameObjectCount = static_cast<uint32_t>(gameObjects.size());
+    header.fileSize = dataStart + writer.data.size();
+
     std::ofstream file(filepath, std::ios::binary | std::ios::trunc);
     if (!file.is_open())
     {
@@ -278,42 +823,273 @@ bool Scene::SaveScene(const std::string& filepath)
         return false;
     }
 
-    try
-    {
-        SceneHeader header;
-        memset(&header, 0, sizeof(header));
+    std::vector<char> prefix(dataStart, 0);
+    memcpy(prefix.data(), &header, sizeof(header));
+    memcpy(prefix.data() + sizeof(header), &chunkCount, sizeof(chunkCount));
+    memcpy(prefix.data() + sizeof(header) + sizeof(chunkCount), writer.chunks.data(), chunkCount * sizeof(SceneChunk));
+    file.write(prefix.data(), prefix.size());
+    file.write(writer.data.data(), writer.data.size());
 
-        memcpy(header.magic, SCENE_MAGIC, 4);
-        header.version = SCENE_VERSION;
-        header.gameObjectCount = static_cast<uint32_t>(gameObjects.size());
+    if (!file)
+    {
+        std::cerr << "Error saving scene: write failed for " << filepath << std::endl;
+        savedPath.clear();
+        return false;
+    }
+    RememberLayout(*this, filepath, writer.chunks, header.fileSize);
+    return true;
+}
 
-        header.fileSize = 0;
-        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+bool Scene::PatchScene()
+{
+    // Scattered record writes only pay off while few entities changed, past that a sequential rewrite is faster
+    if (components.modifiedEntities.empty()) return true;
+    if (components.modifiedEntities.size() * 8 > gameObjects.size()) return false;
 
-        uint32_t nameLength = static_cast<uint32_t>(name.length());
-        file.write(reinterpret_cast<const char*>(&nameLength), sizeof(nameLength));
-        file.write(name.c_str(), nameLength);
+    std::fstream file(savedPath, std::ios::binary | std::ios::in | std::ios::out);
+    if (!file.is_open() || !file.seekg(0, std::ios::end) || static_cast<uint64_t>(file.tellg()) != savedFileSize) return false;
 
-        for (GameObject* obj : gameObjects) obj->Serialize(file);
+    // Every change is staged first, so a change that does not fit in place leaves the file untouched
+    struct Write { uint64_t offset; size_t begin, size; };
+    std::vector<Write> writes; std::vector<char> staging;
+    auto Stage = [&](uint64_t offset, const void* data, size_t size)
+    {
+        writes.push_back({ offset, staging.size(), size });
+        staging.insert(staging.end(), static_cast<const char*>(data), static_cast<const char*>(data) + size);
+    };
+    auto Read = [&](uint64_t offset, void* data, size_t size) { return static_cast<bool>(file.seekg(offset).read(static_cast<char*>(data), size)); };
+    std::string stored;
+    auto SameString = [&](uint32_t offset, uint32_t length, const std::string& str)
+    {
+        if (length != str.size() || offset > savedStringSize || length > savedStringSize - offset) return false;
+        stored.resize(length);
+        return Read(savedStringOffset + offset, stored.data(), length) && stored == str;
+    };
+
+    std::vector<uint32_t> objectIndices = ObjectIndices();
+    bool patchable = true;
+    for (uint32_t entity : components.modifiedEntities)
+    {
+        if (!patchable) break;
+        int mask = components.modifiedMasks[entity];
+        uint32_t index = entity < objectIndices.size() ? objectIndices[entity] : UINT32_MAX;
+        if (index == UINT32_MAX) continue;
+        const GameObject* obj = gameObjects[index];
 
-        std::streampos endPos = file.tellp();
-        header.fileSize = static_cast<uint64_t>(endPos);
+        if (mask & ComponentStore::objectModified)
+        {
+            // Names are stored once per object, so a rename of the same length is rewritten where it is
+            SceneObjectRecord record;
+            uint64_t offset = savedObjectOffset + uint64_t(index) * sizeof(SceneObjectRecord);
+            if (!Read(offset, &record, sizeof(record)) || record.nameLength != obj->name.size()) { patchable = false; break; }
+            if (!SameString(record.nameOffset, record.nameLength, obj->name)) Stage(savedStringOffset + record.nameOffset, obj->name.data(), obj->name.size());
+            record.enabled = obj->enabled;
+            Stage(offset, &record, sizeof(record));
+        }
 
-        file.seekp(0);
-        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        components.ForEachPool([&](auto& pool)
+        {
+            using T = typename std::remove_reference_t<decltype(pool)>::Type;
+            if (!patchable || !(mask & T::Mask) || !pool.Has(entity)) return;
+            uint64_t recordBase = savedComponentOffsets[T::TypeId];
+            if (recordBase == UINT64_MAX) { patchable = false; return; }
+            const T& component = pool.dense[pool.sparse[entity]];
 
-        file.close();
-        return true;
+            if constexpr (!std::is_same_v<T, RendererComponent>)
+            {
+                auto record = ToRecord(component, objectIndices);
+                Stage(recordBase + uint64_t(pool.sparse[entity]) * sizeof(record), &record, sizeof(record));
+            }
+            else
+            {
+                // Mesh paths are shared between renderers, a renderer pointing at a new path needs a rewrite
+                SceneRendererRecord record;
+                uint64_t offset = recordBase + uint64_t(pool.sparse[entity]) * sizeof(SceneRendererRecord);
+                if (!Read(offset, &record, sizeof(record)) || !SameString(record.meshOffset, record.meshLength, component.mesh)) { patchable = false; return; }
+                memcpy(record.color, component.color, sizeof(record.color));
+                record.enabled = component.enabled;
+                Stage(offset, &record, sizeof(record));
+            }
+        });
     }
-    catch (const std::exception& e)
+    if (!patchable) return false;
+
+    file.clear();
+    for (const Write& write : writes) file.seekp(write.offset).write(staging.data() + write.begin, write.size);
+    if (!file.flush())
     {
-        std::cerr << "Error saving scene: " << e.what() << std::endl;
-        file.close();
+        // The file may be partially patched, the fallback rewrites it completely
+        std::cerr << "Error patching scene: write failed for " << savedPath << std::endl;
         return false;
     }
+    components.ClearModified();
+    return true;
 }
 
 bool Scene::LoadScene(const std::string& filepath)
+{
+    MappedFile mapping(filepath);
+    if (!mapping.IsOpen())
+    {
+        std::cerr << "Failed to open file for reading: " << filepath << std::endl;
+        return false;
+    }
+
+    SceneHeader header;
+    if (mapping.size < sizeof(header) || memcmp(mapping.data, SCENE_MAGIC, 4) != 0)
+    {
+        std::cerr << "Invalid scene file: wrong magic number" << std::endl;
+        return false;
+    }
+    memcpy(&header, mapping.data, sizeof(header));
+
+    if (header.version < 1 || header.version > SCENE_VERSION)
+    {
+        std::cerr << "Unsupported scene version: " << header.version
+            << " (expected: 1-" << SCENE_VERSION << ")" << std::endl;
+        return false;
+    }
+    if (header.version < 3) { mapping.Close(); return LoadLegacyScene(filepath); }
+
+    // Everything is validated against the mapping before the current scene is touched
+    const char* base = mapping.data;
+    uint32_t chunkCount = 0;
+    size_t tableOffset = sizeof(header) + sizeof(chunkCount);
+    if (header.fileSize != mapping.size || mapping.size < tableOffset) { std::cerr << "Invalid scene file: truncated" << std::endl; return false; }
+    memcpy(&chunkCount, base + sizeof(header), sizeof(chunkCount));
+    if (chunkCount > (mapping.size - tableOffset) / sizeof(SceneChunk)) { std::cerr << "Invalid scene file: bad chunk table" << std::endl; return false; }
+
+    std::vector<SceneChunk> chunks(chunkCount);
+    memcpy(chunks.data(), base + tableOffset, chunkCount * sizeof(SceneChunk));
+    const SceneChunk* nameChunk = nullptr; const SceneChunk* stringChunk = nullptr; const SceneChunk* objectChunk = nullptr;
+    for (const SceneChunk& chunk : chunks)
+    {
+        if (chunk.offset % 16 != 0 || chunk.offset > mapping.size || chunk.size > mapping.size - chunk.offset)
+        {
+            std::cerr << "Invalid scene file: chunk out of bounds" << std::endl;
+            return false;
+        }
+        if (chunk.type == ChunkName) nameChunk = &chunk;
+        else if (chunk.type == ChunkStrings) stringChunk = &chunk;
+        else if (chunk.type == ChunkObjects) objectChunk = &chunk;
+        else if (chunk.type == ChunkComponents)
+        {
+            size_t recordOffset = AlignChunk(size_t(chunk.count) * sizeof(uint32_t));
+            if (chunk.size < recordOffset + size_t(chunk.count) * chunk.stride)
+            {
+                std::cerr << "Invalid scene file: component chunk too small" << std::endl;
+                return false;
+            }
+        }
+    }
+    if (!nameChunk || !stringChunk || !objectChunk || objectChunk->count != header.gameObjectCount || objectChunk->stride != sizeof(SceneObjectRecord)
+        || objectChunk->size < size_t(objectChunk->count) * sizeof(SceneObjectRecord))
+    {
+        std::cerr << "Invalid scene file: missing or malformed object chunks" << std::endl;
+        return false;
+    }
+
+    // Objects map to entities 0..n-1 of a fresh store, so object indices in the file are entity ids. Records are
+    // fixed size, so record i doubles as the offset index of object i and ranges decode independently.
+    uint32_t objectCount = objectChunk->count;
+    const SceneObjectRecord* objects = reinterpret_cast<const SceneObjectRecord*>(base + objectChunk->offset);
+    SceneDecodeContext context = { objectCount, base + stringChunk->offset, stringChunk->size };
+    ComponentStore loaded;
+    loaded.entityCount = objectCount;
+
+    // Component chunks are checked and their pools sized before any job is queued, so the jobs only fill in slices.
+    // A type listed twice would share a pool, a chunk of an unknown type is skipped.
+    std::vector<const SceneChunk*> componentChunks;
+    uint32_t seenTypes = 0;
+    bool chunksValid = true;
+    for (const SceneChunk& chunk : chunks)
+    {
+        if (chunk.type != ChunkComponents) continue;
+        loaded.ForEachPool([&](auto& pool)
+        {
+            using T = typename std::remove_reference_t<decltype(pool)>::Type;
+            if (chunk.typeId != static_cast<uint32_t>(T::TypeId)) return;
+            if ((seenTypes & T::Mask) || chunk.stride != sizeof(typename SceneRecordOf<T>::Type)) { chunksValid = false; return; }
+            seenTypes |= T::Mask;
+            pool.Resize(chunk.count);
+            componentChunks.push_back(&chunk);
+        });
+    }
+    if (!chunksValid)
+    {
+        std::cerr << "Invalid scene file: duplicate component chunk or unexpected record size" << std::endl;
+        return false;
+    }
+
+    // Object ranges and the record ranges of every column decode side by side, each range writes only its own slice
+    std::vector<std::string> objectNames(objectCount);
+    std::atomic<bool> valid = true;
+    JobSystem& jobSystem = jobs ? *jobs : JobSystem::Serial();
+    const size_t grain = 4096;
+    JobGroup decode;
+    jobSystem.ParallelFor(decode, objectCount, grain, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+            if (objects[i].enabled > 1 || !context.String(objects[i].nameOffset, objects[i].nameLength, objectNames[i])) valid = false;
+    });
+    for (const SceneChunk* chunk : componentChunks)
+    {
+        jobSystem.ParallelFor(decode, chunk->count, grain, [&, chunk](size_t begin, size_t end)
+        {
+            loaded.ForEachPool([&](auto& pool)
+            {
+                using T = typename std::remove_reference_t<decltype(pool)>::Type;
+                if (chunk->typeId == static_cast<uint32_t>(T::TypeId) && !DecodeRange(base + chunk->offset, chunk->count, begin, end, context, pool))
+                    valid = false;
+            });
+        });
+    }
+    jobSystem.Wait(decode);
+
+    // Owners are indexed once their columns are complete, one job per pool
+    JobGroup index;
+    loaded.ForEachPool([&](auto& pool) { jobSystem.Run(index, [&valid, target = &pool, objectCount] { if (!target->IndexEntities(objectCount)) valid = false; }); });
+    jobSystem.Wait(index);
+
+    if (!valid)
+    {
+        std::cerr << "Error loading scene: malformed component data in " << filepath << std::endl;
+        return false;
+    }
+
+    // Only a fully decoded file replaces the current scene
+    name.assign(base + nameChunk->offset, nameChunk->size);
+    ReplaceComponents(std::move(loaded));
+    gameObjects.resize(objectCount);
+
+    // Pointer fixups walk objects rather than pools, so each range only writes its own objects and components
+    JobGroup fixup;
+    jobSystem.ParallelFor(fixup, objectCount, 4096, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            uint32_t entity = static_cast<uint32_t>(i);
+            GameObject* obj = new GameObject(&components, entity, objectNames[i]);
+            obj->enabled = objects[i].enabled != 0;
+            gameObjects[i] = obj;
+            components.ForEachPool([&](auto& pool)
+            {
+                if (!pool.Has(entity)) return;
+                pool.dense[pool.sparse[entity]].gameObject = obj;
+                obj->compMask |= std::remove_reference_t<decltype(pool)>::Type::Mask;
+            });
+        }
+    });
+    jobSystem.Wait(fixup);
+
+    RememberLayout(*this, filepath, chunks, mapping.size);
+
+    ComponentPool<LightComponent>& lights = components.Pool<LightComponent>();
+    mainLight = lights.Size() > 0 ? lights.dense[0].gameObject : nullptr;
+    return true;
+}
+
+bool Scene::LoadLegacyScene(const std::string& filepath)
 {
     std::ifstream file(filepath, std::ios::binary);
     if (!file.is_open())
@@ -322,6 +1098,9 @@ bool Scene::LoadScene(const std::string& filepath)
         return false;
     }
 
+    // Objects are read into a store of their own, the current scene is only replaced once all of them loaded
+    ComponentStore loaded;
+    std::vector<GameObject*> objects;
     try
     {
         SceneHeader header;
@@ -333,10 +1112,10 @@ bool Scene::LoadScene(const std::string& filepath)
             return false;
         }
 
-        if (header.version != SCENE_VERSION)
+        if (header.version < 1 || header.version > SCENE_VERSION)
         {
             std::cerr << "Unsupported scene version: " << header.version
-                << " (expected: " << SCENE_VERSION << ")" << std::endl;
+                << " (expected: 1-" << SCENE_VERSION << ")" << std::endl;
             return false;
         }
 
@@ -345,27 +1124,22 @@ bool Scene::LoadScene(const std::string& filepath)
 
         std::vector<char> nameBuffer(nameLength + 1, '\0');
         file.read(nameBuffer.data(), nameLength);
-        name = std::string(nameBuffer.data());
-
-        ClearScene();
-        gameObjects.reserve(header.gameObjectCount);
 
+        objects.reserve(header.gameObjectCount);
         for (uint32_t i = 0; i < header.gameObjectCount; i++)
         {
-            GameObject* newObj = new GameObject();
-            newObj->Deserialize(file);
-            gameObjects.push_back(newObj);
+            objects.push_back(new GameObject(&loaded));
+            objects.back()->Deserialize(file);
         }
 
-        mainLight = nullptr;
-        for (GameObject* obj : gameObjects)
-        {
-            if (obj->GetComponent<LightComponent>())
-            {
-                mainLight = obj;
-                break;
-            }
-        }
+        name = std::string(nameBuffer.data());
+        ReplaceComponents(std::move(loaded));
+        for (GameObject* obj : objects) obj->store = &components;
+        gameObjects = std::move(objects);
+        savedPath.clear();
+
+        ComponentPool<LightComponent>& lights = components.Pool<LightComponent>();
+        mainLight = lights.Size() > 0 ? lights.dense[0].gameObject : nullptr;
 
         return true;
     }
@@ -373,9 +1147,7 @@ bool Scene::LoadScene(const std::string& filepath)
     {
         std::cerr << "Error loading scene: " << e.what() << std::endl;
 
-        ClearScene();
-        name = "Load Failed";
-
+        for (GameObject* obj : objects) delete obj;
         file.close();
         return false;
     }
@@ -3,6 +3,8 @@
 #include <vector>
 #include <unordered_map>
 #include "GameObject.h"
+#include "JobSystem.h"
+#include "TransformHierarchy.h"
 #include "../Physics/Physics.h"
 #include "../../3rdParty/GLM/glm.hpp"
 #include "../../3rdParty/GLM/gtc/type_ptr.hpp"
@@ -11,47 +13,127 @@
 class Shader;
 class Resource;
 
-struct BaseGeometry 
+// One draw of glMultiDrawElementsIndirect, in the layout GL reads from the indirect buffer
+struct DrawElementsIndirectCommand
 {
-    GLuint VAO = 0, VBO = 0, EBO = 0;
-    uint32_t vertexCount = 0, indexCount = 0;
+    uint32_t count, instanceCount, firstIndex;
+    int32_t baseVertex;
+    uint32_t baseInstance;
 };
 
+// Instance data of every batch shares one set of SSBOs plus the indirect buffer holding one command per batch.
+// Each buffer is a persistently mapped ring of regionCount regions, the GPU reads one region while the next is
+// written and a fence per region keeps the CPU from overwriting data a frame in flight still reads.
+struct InstanceBuffers
+{
+    static constexpr int regionCount = 3;
+    GLuint modelSSBO = 0, colorSSBO = 0, visibleSSBO = 0, commandBuffer = 0;
+    char* mappedModels = nullptr; char* mappedColors = nullptr; char* mappedVisible = nullptr; char* mappedCommands = nullptr;
+    size_t modelRegionSize = 0, colorRegionSize = 0, visibleRegionSize = 0, commandRegionSize = 0;
+    size_t capacity = 0, commandCapacity = 0;
+    GLsync fences[regionCount] = {};
+    int region = 0;
+
+    InstanceBuffers() = default;
+    ~InstanceBuffers();
+    InstanceBuffers(const InstanceBuffers&) = delete;
+    InstanceBuffers& operator=(const InstanceBuffers&) = delete;
+
+    bool Reserve(size_t instances, size_t commands); // True when reallocated, every region then starts out empty
+    void Advance(); // Moves on to the next region once the GPU is done with it
+    void Bind() const;
+    void Fence();
+    void Release();
+};
+
+// Instances keep their slot across frames: slots is entity -> slot and entities is slot -> entity, removal
+// swaps the last slot into the hole. A batch owns capacity slots of the shared instance buffers starting at
+// instanceBase, and each region only receives the slots dirtied since it was last written.
+// World bounds are kept per slot as separate center/extent arrays so the frustum test runs over flat floats,
+// the surviving slots are compacted into visibleSlots and the shader reaches instance data through them.
 struct GeometryInstances 
 {
-    RendererComponent::Type type;
+    static constexpr uint32_t invalid = UINT32_MAX;
+    static constexpr int regionCount = InstanceBuffers::regionCount;
+    MeshHandle mesh;
+    AABB localBound = { glm::vec3(-0.5f), glm::vec3(0.5f) };
+    bool meshBound = false; // localBound comes from the loaded mesh rather than the unit box placeholder
 
     std::vector<glm::mat4> modelMatrices;
     std::vector<glm::vec4> instanceColors;
+    std::vector<uint32_t> entities, slots;
+    std::vector<float> centerX, centerY, centerZ, extentX, extentY, extentZ;
+    std::vector<uint32_t> visibleSlots; size_t visibleCount = 0;
+    std::vector<uint8_t> boundStale; size_t staleBegin = 0, staleEnd = 0; // Slots set since the bounds were last computed
+    std::vector<uint32_t> pending; // Entities queued by Scene::UpdateInstances, written by the batch's job
+
+    size_t instanceCount = 0, capacity = 0, instanceBase = 0;
+    size_t dirtyBegin[regionCount] = {}, dirtyEnd[regionCount] = {};
+
+    GeometryInstances(MeshHandle m) : mesh(m) {}
 
-    GLuint modelSSBO = 0, colorSSBO = 0;
-    size_t instanceCount = 0; bool dirty = true;
+    bool Has(uint32_t entity) const { return entity < slots.size() && slots[entity] != invalid; }
+    void Set(uint32_t entity, const glm::mat4& model, const glm::vec4& color);
+    void Remove(uint32_t entity);
+    void Clear();
+    void MarkDirty(size_t slot);
+    void MarkAllDirty();
+    void UpdateBound(size_t slot);
+    void UpdateBounds(JobSystem& jobs);
+    void SetLocalBound(const AABB& bound);
+    void Cull(const glm::vec4 planes[6]);
 
-    GeometryInstances(RendererComponent::Type t) : type(t) {}
-    ~GeometryInstances();
+    void Upload(InstanceBuffers& buffers);
+    void UploadVisible(InstanceBuffers& buffers, size_t visibleBase) const; // Global instance indices of the visible slots
 };
 
 struct Scene
 {
     std::string name;
+    ComponentStore components;
     std::vector<GameObject*> gameObjects;
+    TransformHierarchy hierarchy;
 
     GameObject* mainLight = nullptr;
-    std::unordered_map<RendererComponent::Type, BaseGeometry> baseGeometries;
-    std::unordered_map<RendererComponent::Type, GeometryInstances*> geometryBatches;
+    Resource* resource = nullptr;
+    JobSystem* jobs = nullptr; // Engine's scheduler, without one load and cull work runs on the calling thread
+    // Instance batches per registry mesh, created the first time a renderer uses the mesh
+    std::unordered_map<MeshHandle, GeometryInstances*> geometryBatches;
+    std::vector<MeshHandle> instanceMeshes; // Entity -> mesh of the batch holding its instance
+    uint64_t renderVersion = UINT64_MAX; // components.version the batches were last rebuilt against
+    uint64_t meshVersion = 0; // resource->meshVersion the batch bounds were last refreshed against
+    InstanceBuffers instances;
+    size_t drawCount = 0; // Commands in the current region of instances.commandBuffer
+    GLuint frameUBO = 0; // FrameUniforms, written once per Render
+    // File last saved or loaded in the chunked format. While components.version still matches, its chunk layout matches
+    // the pools and saving to the same path only rewrites the records of modified entities.
+    std::string savedPath;
+    uint64_t savedVersion = UINT64_MAX, savedFileSize = 0, savedObjectOffset = 0, savedStringOffset = 0, savedStringSize = 0;
+    uint64_t savedComponentOffsets[ComponentStore::poolCount] = {};
 
     Scene();
     ~Scene();
 
+    GameObject* CreateGameObject(const std::string& objectName = "New GameObject");
+    void DestroyGameObject(GameObject* gameObject); // Its children become roots
+    bool SetParent(GameObject* child, GameObject* parent); // nullptr detaches, fails if parent is child or below it
+    void UpdateHierarchy();
     void ClearScene();
+    void ReplaceComponents(ComponentStore&& loaded); // Clears the scene and takes over a store decoded on the side
     bool SaveScene(const std::string& filepath);
     bool LoadScene(const std::string& filepath);
+    bool LoadLegacyScene(const std::string& filepath); // Versions 1-2, one stream read per field
+    bool PatchScene(); // In-place save of modified records, false when the file has to be rewritten
+    std::vector<uint32_t> ObjectIndices() const; // Entity -> index in gameObjects
 
     void CollectRenderData();
+    void UpdateInstances(const std::vector<uint32_t>& entityList);
+    void CullInstances(const glm::mat4& viewProjection);
     void UpdateSSBOs();
     void Render(Shader* shader, const glm::mat4& view, const glm::mat4& projection, const glm::vec3& viewPos, int viewportWidth, int viewportHeight);
 
-    void InitializeBaseGeometries(Resource* resource);
+    void SetResource(Resource* _resource);
+    GeometryInstances* GetBatch(MeshHandle mesh);
 
     glm::vec3 GetLightColor() const;
     glm::vec3 GetLightDirection() const;
@@ -0,0 +1,273 @@
+#include "TransformBatch.h"
+#include "GameObject.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#define TRANSFORM_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_AVX // MSVC emits AVX intrinsics without /arch:AVX, the caller checks the CPU first
+#else
+#include <cpuid.h>
+#define TARGET_AVX __attribute__((target("avx")))
+#endif
+#endif
+#if defined(TRANSFORM_X86) && (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#define TRANSFORM_SSE
+#endif
+
+// The vector kernels below spell out this same arithmetic per lane, so all kernels round alike
+static void ComposeScalar(const TransformArrays& in, size_t begin, size_t end, glm::mat4* models, glm::vec3* forwards)
+{
+    for (size_t i = begin; i < end; i++)
+    {
+        float x = in.rotation[0][i], y = in.rotation[1][i], z = in.rotation[2][i], w = in.rotation[3][i];
+        float x2 = x + x, y2 = y + y, z2 = z + z;
+        float xx = x * x2, yy = y * y2, zz = z * z2, xy = x * y2, xz = x * z2, yz = y * z2, wx = w * x2, wy = w * y2, wz = w * z2;
+        float sx = in.scale[0][i], sy = in.scale[1][i], sz = in.scale[2][i];
+
+        glm::mat4& model = models[i];
+        model[0] = glm::vec4((1.0f - (yy + zz)) * sx, (xy + wz) * sx, (xz - wy) * sx, 0.0f);
+        model[1] = glm::vec4((xy - wz) * sy, (1.0f - (xx + zz)) * sy, (yz + wx) * sy, 0.0f);
+        model[2] = glm::vec4((xz + wy) * sz, (yz - wx) * sz, (1.0f - (xx + yy)) * sz, 0.0f);
+        model[3] = glm::vec4(in.position[0][i], in.position[1][i], in.position[2][i], 1.0f);
+
+        if (!forwards) continue;
+        glm::vec3 axis = -glm::vec3(model[2]);
+        float length = std::sqrt(glm::dot(axis, axis));
+        forwards[i] = length > 1e-12f ? axis / length : glm::vec3(0.0f, 0.0f, -1.0f);
+    }
+}
+
+#ifdef TRANSFORM_SSE
+// Each register holds one matrix element of 4 transforms, a 4x4 transpose per column turns them back into columns
+static size_t ComposeSSE(const TransformArrays& in, size_t count, glm::mat4* models, glm::vec3* forwards)
+{
+    const __m128 one = _mm_set1_ps(1.0f), zero = _mm_setzero_ps(), epsilon = _mm_set1_ps(1e-12f), minusOne = _mm_set1_ps(-1.0f);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 x = _mm_loadu_ps(in.rotation[0] + i), y = _mm_loadu_ps(in.rotation[1] + i);
+        __m128 z = _mm_loadu_ps(in.rotation[2] + i), w = _mm_loadu_ps(in.rotation[3] + i);
+        __m128 x2 = _mm_add_ps(x, x), y2 = _mm_add_ps(y, y), z2 = _mm_add_ps(z, z);
+        __m128 xx = _mm_mul_ps(x, x2), yy = _mm_mul_ps(y, y2), zz = _mm_mul_ps(z, z2);
+        __m128 xy = _mm_mul_ps(x, y2), xz = _mm_mul_ps(x, z2), yz = _mm_mul_ps(y, z2);
+        __m128 wx = _mm_mul_ps(w, x2), wy = _mm_mul_ps(w, y2), wz = _mm_mul_ps(w, z2);
+        __m128 sx = _mm_loadu_ps(in.scale[0] + i), sy = _mm_loadu_ps(in.scale[1] + i), sz = _mm_loadu_ps(in.scale[2] + i);
+
+        __m128 column[4][4] = {
+            { _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx), _mm_mul_ps(_mm_add_ps(xy, wz), sx), _mm_mul_ps(_mm_sub_ps(xz, wy), sx), zero },
+            { _mm_mul_ps(_mm_sub_ps(xy, wz), sy), _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy), _mm_mul_ps(_mm_add_ps(yz, wx), sy), zero },
+            { _mm_mul_ps(_mm_add_ps(xz, wy), sz), _mm_mul_ps(_mm_sub_ps(yz, wx), sz), _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz), zero },
+            { _mm_loadu_ps(in.position[0] + i), _mm_loadu_ps(in.position[1] + i), _mm_loadu_ps(in.position[2] + i), one } };
+
+        if (forwards)
+        {
+            __m128 ax = _mm_sub_ps(zero, column[2][0]), ay = _mm_sub_ps(zero, column[2][1]), az = _mm_sub_ps(zero, column[2][2]);
+            __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, ax), _mm_mul_ps(ay, ay)), _mm_mul_ps(az, az)));
+            __m128 valid = _mm_cmpgt_ps(length, epsilon);
+            alignas(16) float fx[4], fy[4], fz[4];
+            _mm_store_ps(fx, _mm_and_ps(valid, _mm_div_ps(ax, length)));
+            _mm_store_ps(fy, _mm_and_ps(valid, _mm_div_ps(ay, length)));
+            _mm_store_ps(fz, _mm_or_ps(_mm_and_ps(valid, _mm_div_ps(az, length)), _mm_andnot_ps(valid, minusOne)));
+            for (int lane = 0; lane < 4; lane++) forwards[i + lane] = glm::vec3(fx[lane], fy[lane], fz[lane]);
+        }
+
+        for (int c = 0; c < 4; c++)
+        {
+            _MM_TRANSPOSE4_PS(column[c][0], column[c][1], column[c][2], column[c][3]);
+            for (int lane = 0; lane < 4; lane++) _mm_storeu_ps(&models[i + lane][c][0], column[c][lane]);
+        }
+    }
+    return i;
+}
+#endif
+
+#ifdef TRANSFORM_X86
+// 8 transforms per step. The transpose works within each 128-bit half: the low half holds transforms 0-3,
+// the high half 4-7.
+TARGET_AVX static size_t ComposeAVX(const TransformArrays& in, size_t count, glm::mat4* models, glm::vec3* forwards)
+{
+    const __m256 one = _mm256_set1_ps(1.0f), zero = _mm256_setzero_ps(), epsilon = _mm256_set1_ps(1e-12f), minusOne = _mm256_set1_ps(-1.0f);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps(in.rotation[0] + i), y = _mm256_loadu_ps(in.rotation[1] + i);
+        __m256 z = _mm256_loadu_ps(in.rotation[2] + i), w = _mm256_loadu_ps(in.rotation[3] + i);
+        __m256 x2 = _mm256_add_ps(x, x), y2 = _mm256_add_ps(y, y), z2 = _mm256_add_ps(z, z);
+        __m256 xx = _mm256_mul_ps(x, x2), yy = _mm256_mul_ps(y, y2), zz = _mm256_mul_ps(z, z2);
+        __m256 xy = _mm256_mul_ps(x, y2), xz = _mm256_mul_ps(x, z2), yz = _mm256_mul_ps(y, z2);
+        __m256 wx = _mm256_mul_ps(w, x2), wy = _mm256_mul_ps(w, y2), wz = _mm256_mul_ps(w, z2);
+        __m256 sx = _mm256_loadu_ps(in.scale[0] + i), sy = _mm256_loadu_ps(in.scale[1] + i), sz = _mm256_loadu_ps(in.scale[2] + i);
+
+        __m256 column[4][4] = {
+            { _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), sx), _mm256_mul_ps(_mm256_add_ps(xy, wz), sx), _mm256_mul_ps(_mm256_sub_ps(xz, wy), sx), zero },
+            { _mm256_mul_ps(_mm256_sub_ps(xy, wz), sy), _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, zz)), sy), _mm256_mul_ps(_mm256_add_ps(yz, wx), sy), zero },
+            { _mm256_mul_ps(_mm256_add_ps(xz, wy), sz), _mm256_mul_ps(_mm256_sub_ps(yz, wx), sz), _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, yy)), sz), zero },
+            { _mm256_loadu_ps(in.position[0] + i), _mm256_loadu_ps(in.position[1] + i), _mm256_loadu_ps(in.position[2] + i), one } };
+
+        if (forwards)
+        {
+            __m256 ax = _mm256_sub_ps(zero, column[2][0]), ay = _mm256_sub_ps(zero, column[2][1]), az = _mm256_sub_ps(zero, column[2][2]);
+            __m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, ax), _mm256_mul_ps(ay, ay)), _mm256_mul_ps(az, az)));
+            __m256 valid = _mm256_cmp_ps(length, epsilon, _CMP_GT_OQ);
+            alignas(32) float fx[8], fy[8], fz[8];
+            _mm256_store_ps(fx, _mm256_and_ps(valid, _mm256_div_ps(ax, length)));
+            _mm256_store_ps(fy, _mm256_and_ps(valid, _mm256_div_ps(ay, length)));
+            _mm256_store_ps(fz, _mm256_blendv_ps(minusOne, _mm256_div_ps(az, length), valid));
+            for (int lane = 0; lane < 8; lane++) forwards[i + lane] = glm::vec3(fx[lane], fy[lane], fz[lane]);
+        }
+
+        for (int c = 0; c < 4; c++)
+        {
+            __m256 t0 = _mm256_unpacklo_ps(column[c][0], column[c][1]), t1 = _mm256_unpackhi_ps(column[c][0], column[c][1]);
+            __m256 t2 = _mm256_unpacklo_ps(column[c][2], column[c][3]), t3 = _mm256_unpackhi_ps(column[c][2], column[c][3]);
+            __m256 lanes[4] = { _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0)), _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2)),
+                _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0)), _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2)) };
+            for (int lane = 0; lane < 4; lane++)
+            {
+                _mm_storeu_ps(&models[i + lane][c][0], _mm256_castps256_ps128(lanes[lane]));
+                _mm_storeu_ps(&models[i + lane + 4][c][0], _mm256_extractf128_ps(lanes[lane], 1));
+            }
+        }
+    }
+    return i;
+}
+
+static bool CpuHasAVX()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    // The OS has to save the upper register halves too (XCR0 bits 1 and 2)
+    return (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+#else
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & (1u << 27)) || !(ecx & (1u << 28))) return false;
+    unsigned int xcr0, xcr0High;
+    __asm__("xgetbv" : "=a"(xcr0), "=d"(xcr0High) : "c"(0));
+    return (xcr0 & 6) == 6;
+#endif
+}
+#endif
+
+bool TransformKernelSupported(TransformKernel kernel)
+{
+    switch (kernel)
+    {
+    case KernelScalar: return true;
+#ifdef TRANSFORM_SSE
+    case KernelSSE: return true;
+#endif
+#ifdef TRANSFORM_X86
+    case KernelAVX: { static const bool avx = CpuHasAVX(); return avx; }
+#endif
+    default: return false;
+    }
+}
+
+TransformKernel BestTransformKernel()
+{
+    static const TransformKernel best = TransformKernelSupported(KernelAVX) ? KernelAVX : TransformKernelSupported(KernelSSE) ? KernelSSE : KernelScalar;
+    return best;
+}
+
+const char* TransformKernelName(TransformKernel kernel)
+{
+    static const char* names[KernelCount] = { "scalar", "SSE", "AVX" };
+    return kernel < KernelCount ? names[kernel] : "unknown";
+}
+
+void ComposeTransforms(const TransformArrays& input, size_t count, glm::mat4* models, glm::vec3* forwards, TransformKernel kernel)
+{
+    if (!TransformKernelSupported(kernel)) kernel = KernelScalar;
+    size_t done = 0;
+#ifdef TRANSFORM_X86
+    if (kernel == KernelAVX) done = ComposeAVX(input, count, models, forwards);
+#endif
+#ifdef TRANSFORM_SSE
+    if (kernel == KernelSSE) done = ComposeSSE(input, count, models, forwards);
+#endif
+    ComposeScalar(input, done, count, models, forwards);
+}
+
+void ComputeModels(TransformComponent* const* transforms, size_t count)
+{
+    const size_t blockSize = 64;
+    float columns[10][blockSize];
+    glm::mat4 models[blockSize]; glm::vec3 forwards[blockSize];
+    TransformArrays input = { { columns[0], columns[1], columns[2] }, { columns[3], columns[4], columns[5], columns[6] }, { columns[7], columns[8], columns[9] } };
+    TransformKernel kernel = BestTransformKernel();
+
+    for (size_t begin = 0; begin < count; begin += blockSize)
+    {
+        size_t size = std::min(blockSize, count - begin);
+        for (size_t i = 0; i < size; i++)
+        {
+            const TransformComponent& transform = *transforms[begin + i];
+            for (int axis = 0; axis < 3; axis++) { columns[axis][i] = transform.position[axis]; columns[7 + axis][i] = transform.scale[axis]; }
+            columns[3][i] = transform.rotation.x; columns[4][i] = transform.rotation.y; columns[5][i] = transform.rotation.z; columns[6][i] = transform.rotation.w;
+        }
+        ComposeTransforms(input, size, models, forwards, kernel);
+        for (size_t i = 0; i < size; i++) { transforms[begin + i]->model = models[i]; transforms[begin + i]->forward = forwards[i]; }
+    }
+}
+
+bool BenchmarkTransforms(size_t count)
+{
+    if (count == 0) { std::cerr << "Nothing to benchmark" << std::endl; return false; }
+
+    std::vector<TransformComponent> transforms(count);
+    std::vector<TransformComponent*> pointers(count);
+    std::vector<float> columns[10];
+    for (std::vector<float>& column : columns) column.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        TransformComponent& transform = transforms[i];
+        for (int axis = 0; axis < 3; axis++) { transform.position[axis] = float(i % 97) - 48.0f + axis; transform.scale[axis] = 0.5f + float((i + axis) % 7) * 0.25f; }
+        transform.SetEulerAngles(glm::vec3(float(i % 180) - 90.0f, float(i % 360), float(i % 90)));
+        pointers[i] = &transform;
+        for (int axis = 0; axis < 3; axis++) { columns[axis][i] = transform.position[axis]; columns[7 + axis][i] = transform.scale[axis]; }
+        columns[3][i] = transform.rotation.x; columns[4][i] = transform.rotation.y; columns[5][i] = transform.rotation.z; columns[6][i] = transform.rotation.w;
+    }
+    TransformArrays input = { { columns[0].data(), columns[1].data(), columns[2].data() },
+        { columns[3].data(), columns[4].data(), columns[5].data(), columns[6].data() }, { columns[7].data(), columns[8].data(), columns[9].data() } };
+    std::vector<glm::mat4> models(count), reference(count);
+    std::vector<glm::vec3> forwards(count);
+
+    // Best of a few runs, per transform
+    auto Time = [count](auto&& run)
+    {
+        double best = 1e30;
+        for (int repeat = 0; repeat < 5; repeat++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            run();
+            best = std::min(best, std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+        }
+        return best / double(count);
+    };
+
+    double single = Time([&] { for (TransformComponent& transform : transforms) transform.ComputeModel(); });
+    for (size_t i = 0; i < count; i++) reference[i] = transforms[i].model;
+    std::cout << count << " transforms, ComputeModel one at a time: " << single << " ns each" << std::endl;
+
+    for (int kernel = 0; kernel < KernelCount; kernel++)
+    {
+        if (!TransformKernelSupported(TransformKernel(kernel))) continue;
+        double cost = Time([&] { ComposeTransforms(input, count, models.data(), forwards.data(), TransformKernel(kernel)); });
+        float error = 0;
+        for (size_t i = 0; i < count; i++)
+            for (int c = 0; c < 4; c++) for (int r = 0; r < 4; r++) error = std::max(error, std::abs(models[i][c][r] - reference[i][c][r]));
+        std::cout << TransformKernelName(TransformKernel(kernel)) << " kernel: " << cost << " ns each, max difference " << error << std::endl;
+    }
+
+    double gathered = Time([&] { ComputeModels(pointers.data(), count); });
+    std::cout << "ComputeModels (" << TransformKernelName(BestTransformKernel()) << ", gather and write back): " << gathered << " ns each" << std::endl;
+    return true;
+}
\ No newline at end of file
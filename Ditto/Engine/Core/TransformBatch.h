@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include "../../3rdParty/GLM/glm.hpp"
+
+struct TransformComponent;
+
+// Builds model matrices and forward vectors for many transforms at once. Input is one float array per component
+// (structure of arrays), the vector kernels compose 8 (AVX) or 4 (SSE) transforms per step and the rest runs
+// scalar. Every kernel matches TransformComponent::LocalMatrix and Forward up to rounding.
+enum TransformKernel { KernelScalar, KernelSSE, KernelAVX, KernelCount };
+
+struct TransformArrays
+{
+    const float* position[3];
+    const float* rotation[4]; // Quaternion x, y, z, w
+    const float* scale[3];
+};
+
+TransformKernel BestTransformKernel(); // Widest kernel both the build and this CPU support, picked once
+bool TransformKernelSupported(TransformKernel kernel);
+const char* TransformKernelName(TransformKernel kernel);
+
+// forwards may be null when only the matrices are wanted
+void ComposeTransforms(const TransformArrays& input, size_t count, glm::mat4* models, glm::vec3* forwards, TransformKernel kernel);
+inline void ComposeTransforms(const TransformArrays& input, size_t count, glm::mat4* models, glm::vec3* forwards)
+{
+    ComposeTransforms(input, count, models, forwards, BestTransformKernel());
+}
+
+// ComputeModel for a list of transforms: gathers them in blocks on the stack, composes and writes model and
+// forward back. Like ComputeModel it marks nothing dirty and the model is the local matrix.
+void ComputeModels(TransformComponent* const* transforms, size_t count);
+
+// Ditto --bench-transforms: prints the per-transform cost of ComputeModel and of each kernel
+bool BenchmarkTransforms(size_t count);
\ No newline at end of file
@@ -0,0 +1,73 @@
+#include "TransformHierarchy.h"
+
+void TransformHierarchy::Rebuild(ComponentStore& components)
+{
+    ComponentPool<TransformComponent>& pool = components.Pool<TransformComponent>();
+    entities.clear(); parents.clear();
+
+    // A link to an entity without a transform counts as no link. Links that form a cycle are never reached from a
+    // root, those transforms stay out of the order and keep their local matrix.
+    auto ParentOf = [&](const TransformComponent& transform)
+    {
+        return transform.parent != TransformComponent::noParent && pool.Has(transform.parent) ? transform.parent : invalid;
+    };
+
+    // Children of every entity as one flat list, childStart[e]..childStart[e + 1] are the children of e
+    std::vector<uint32_t> childStart(size_t(components.entityCount) + 1, 0), children;
+    for (const TransformComponent& transform : pool.dense)
+        if (uint32_t parent = ParentOf(transform); parent != invalid) childStart[parent + 1]++;
+    for (size_t entity = 0; entity < components.entityCount; entity++) childStart[entity + 1] += childStart[entity];
+    children.resize(childStart.back());
+    std::vector<uint32_t> cursor(childStart.begin(), childStart.end() - 1);
+    for (size_t i = 0; i < pool.Size(); i++)
+        if (uint32_t parent = ParentOf(pool.dense[i]); parent != invalid) children[cursor[parent]++] = pool.entities[i];
+
+    // Roots with children first, then each level follows the one above it
+    for (size_t i = 0; i < pool.Size(); i++)
+    {
+        uint32_t entity = pool.entities[i];
+        if (ParentOf(pool.dense[i]) == invalid && childStart[entity + 1] > childStart[entity]) { entities.push_back(entity); parents.push_back(invalid); }
+    }
+    for (size_t node = 0; node < entities.size(); node++)
+    {
+        uint32_t entity = entities[node];
+        for (uint32_t child = childStart[entity]; child < childStart[entity + 1]; child++)
+        {
+            entities.push_back(children[child]);
+            parents.push_back(static_cast<uint32_t>(node));
+        }
+    }
+
+    size_t count = entities.size();
+    transforms.resize(count); locals.resize(count); worlds.resize(count); changed.assign(count, 0);
+    for (size_t node = 0; node < count; node++)
+    {
+        transforms[node] = pool.Get(entities[node]);
+        locals[node] = transforms[node]->LocalMatrix();
+    }
+    builtVersion = components.version; linksChanged = false;
+}
+
+void TransformHierarchy::Update(ComponentStore& components)
+{
+    bool rebuilt = builtVersion != components.version || linksChanged;
+    if (rebuilt) Rebuild(components);
+
+    std::vector<uint8_t>& moved = components.movedFlags;
+    for (size_t node = 0; node < entities.size(); node++)
+    {
+        uint32_t entity = entities[node], parent = parents[node];
+        bool own = entity < moved.size() && moved[entity];
+        if (own) { moved[entity] = 0; if (!rebuilt) locals[node] = transforms[node]->LocalMatrix(); }
+
+        changed[node] = rebuilt || own || (parent != invalid && changed[parent]);
+        if (!changed[node]) continue;
+
+        worlds[node] = parent == invalid ? locals[node] : worlds[parent] * locals[node];
+        TransformComponent* transform = transforms[node];
+        transform->model = worlds[node];
+        transform->forward = TransformComponent::Forward(worlds[node]);
+        // A moved transform is already queued for the renderer, its descendants are queued here
+        if (!own) components.MarkRenderDirty(entity);
+    }
+}
\ No newline at end of file
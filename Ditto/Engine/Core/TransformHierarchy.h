@@ -0,0 +1,26 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "GameObject.h"
+#include "../../3rdParty/GLM/glm.hpp"
+
+// Breadth-first copy of every transform that has a parent or children, so each node comes after its parent and one
+// forward pass brings all world matrices up to date. Local and world matrices are cached per node: a node is only
+// recomposed when its own transform moved or its parent was recomposed earlier in the same pass. Transforms outside
+// the hierarchy need no composing, their model already is their world matrix.
+struct TransformHierarchy
+{
+    static constexpr uint32_t invalid = UINT32_MAX;
+    std::vector<uint32_t> entities, parents; // Node -> entity, node -> parent node
+    std::vector<TransformComponent*> transforms; // Node -> component, valid while the store version is unchanged
+    std::vector<glm::mat4> locals, worlds;
+    std::vector<uint8_t> changed; // Recomposed in the current pass, read by the children further down
+    uint64_t builtVersion = UINT64_MAX; // components.version the order was built against
+    bool linksChanged = true; // A parent was set or cleared since the order was built
+
+    void Update(ComponentStore& components);
+    size_t Size() const { return entities.size(); }
+
+private:
+    void Rebuild(ComponentStore& components);
+};
\ No newline at end of file
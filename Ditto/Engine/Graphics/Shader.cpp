@@ -2,69 +2,329 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <vector>
 #include "../../3rdParty/GLAD/glad.h"
 #include "../../3rdParty/GLM/ext/matrix_transform.hpp"
 #include "../../3rdParty/GLM/gtc/type_ptr.hpp"
 
-static std::string ReadFile(const char* path)
+// KHR_parallel_shader_compile and its ARB twin, newer than the generated loader
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// Linked programs are kept in Cache/ next to the shader sources as the driver's glGetProgramBinary output. The
+// key hashes both sources and the driver strings, a binary from other sources or another driver is never loaded.
+struct ProgramCacheHeader
+{
+    char magic[4];
+    uint32_t version, binaryFormat, binarySize;
+    uint64_t key;
+};
+
+const uint32_t PROGRAM_CACHE_VERSION = 1;
+const char PROGRAM_CACHE_MAGIC[4] = { 'P', 'R', 'G', '\0' };
+
+static bool ReadFile(const char* path, std::string& text)
 {
     std::ifstream file(path, std::ios::in | std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr << "Failed to open shader file: " << path << std::endl;
+        return false;
+    }
     std::stringstream ss;
     ss << file.rdbuf();
-    return ss.str();
+    text = ss.str();
+    return true;
+}
+
+// FNV-1a, terminated so that "ab" + "c" and "a" + "bc" differ
+static uint64_t HashText(uint64_t hash, const char* text)
+{
+    for (const char* c = text ? text : ""; ; c++)
+    {
+        hash = (hash ^ static_cast<uint8_t>(*c)) * 1099511628211ULL;
+        if (*c == '\0') return hash;
+    }
+}
+
+std::string ProgramCachePath(const char* vertexPath, const char* fragmentPath)
+{
+    std::filesystem::path vertex(vertexPath), fragment(fragmentPath);
+    return (vertex.parent_path() / "Cache" / (vertex.stem().string() + "_" + fragment.stem().string() + ".program")).string();
+}
+
+static bool LoadProgramBinary(const std::string& cachePath, uint64_t key, uint32_t program)
+{
+    std::ifstream file(cachePath, std::ios::binary);
+    if (!file.is_open()) return false;
+
+    ProgramCacheHeader header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || memcmp(header.magic, PROGRAM_CACHE_MAGIC, 4) != 0
+        || header.version != PROGRAM_CACHE_VERSION || header.key != key) return false;
+    std::vector<char> binary(header.binarySize);
+    if (!file.read(binary.data(), binary.size())) return false;
+
+    // A driver update can reject its own old binaries, that only costs a normal compile
+    glProgramBinary(program, header.binaryFormat, binary.data(), static_cast<GLsizei>(binary.size()));
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    return linked == GL_TRUE;
+}
+
+static void SaveProgramBinary(const std::string& cachePath, uint64_t key, uint32_t program)
+{
+    GLint formats = 0, size = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+    if (formats == 0 || size <= 0) return;
+
+    ProgramCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PROGRAM_CACHE_MAGIC, 4);
+    header.version = PROGRAM_CACHE_VERSION; header.key = key;
+    std::vector<char> binary(size);
+    GLsizei written = 0; GLenum format = 0;
+    glGetProgramBinary(program, size, &written, &format, binary.data());
+    if (written <= 0) return;
+    header.binaryFormat = format; header.binarySize = static_cast<uint32_t>(written);
+
+    // Same temporary-then-rename write as cooked meshes, a half written binary never carries a valid key
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(cachePath).parent_path(), error);
+    std::string tempPath = cachePath + ".tmp";
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        std::cerr << "Failed to open file for writing: " << tempPath << std::endl;
+        return;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(binary.data(), written);
+    file.close();
+    if (!file) { std::cerr << "Failed to write program cache: " << tempPath << std::endl; return; }
+    std::filesystem::rename(tempPath, cachePath, error);
+    if (error) std::cerr << "Failed to replace program cache " << cachePath << ": " << error.message() << std::endl;
+}
+
+bool Shader::parallelCompile = false;
+
+// Reports the compile log of a stage that failed, true when it compiled
+static bool CheckStage(uint32_t shader, const std::string& path)
+{
+    GLint compiled = GL_FALSE, length = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (compiled == GL_TRUE) return true;
+
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+    std::string log(std::max(length, 1), '\0');
+    glGetShaderInfoLog(shader, length, nullptr, log.data());
+    std::cerr << "Failed to compile " << path << ":\n" << log.c_str() << std::endl;
+    return false;
+}
+
+void Shader::EnableParallelCompile(void* (*loadProc)(const char* name))
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count && !parallelCompile; i++)
+    {
+        std::string extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, GLuint(i)));
+        const char* function = extension == "GL_KHR_parallel_shader_compile" ? "glMaxShaderCompilerThreadsKHR"
+            : extension == "GL_ARB_parallel_shader_compile" ? "glMaxShaderCompilerThreadsARB" : nullptr;
+        if (!function) continue;
+
+        // 0xFFFFFFFF lets the driver pick its own thread count
+        typedef void (APIENTRYP MaxShaderCompilerThreads)(GLuint count);
+        if (MaxShaderCompilerThreads maxThreads = reinterpret_cast<MaxShaderCompilerThreads>(loadProc(function))) maxThreads(0xFFFFFFFFu);
+        parallelCompile = true;
+    }
 }
 
 Shader::Shader(const char* vertexPath, const char* fragmentPath)
 {
-    std::string vertSrc = ReadFile(vertexPath);
-    std::string fragSrc = ReadFile(fragmentPath);
+    Load(vertexPath, fragmentPath);
+}
 
-    const char* vSrc = vertSrc.c_str();
-    const char* fSrc = fragSrc.c_str();
+bool Shader::Load(const char* vertexPath, const char* fragmentPath)
+{
+    return Begin(vertexPath, fragmentPath) && Finish();
+}
+
+bool Shader::Reload()
+{
+    return Begin(vertexPath.c_str(), fragmentPath.c_str());
+}
 
-    uint32_t vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &vSrc, nullptr);
-    glCompileShader(vertex);
+bool Shader::Update()
+{
+    if (!pending.program) return false;
+    if (parallelCompile && !pending.cached)
+    {
+        GLint done = GL_FALSE;
+        glGetProgramiv(pending.program, GL_COMPLETION_STATUS_KHR, &done);
+        if (done != GL_TRUE) return false;
+    }
+    return Finish();
+}
 
-    uint32_t fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &fSrc, nullptr);
-    glCompileShader(fragment);
+bool Shader::Begin(const char* vertexPath, const char* fragmentPath)
+{
+    PendingProgram next;
+    next.vertexPath = vertexPath; next.fragmentPath = fragmentPath;
+    Discard();
 
-    id = glCreateProgram();
-    glAttachShader(id, vertex);
-    glAttachShader(id, fragment);
-    glLinkProgram(id); glUseProgram(id);
+    std::string vertSrc, fragSrc;
+    if (!ReadFile(vertexPath, vertSrc) || !ReadFile(fragmentPath, fragSrc)) return false;
 
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
+    next.key = 14695981039346656037ULL;
+    for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) next.key = HashText(next.key, reinterpret_cast<const char*>(glGetString(name)));
+    next.key = HashText(HashText(next.key, vertSrc.c_str()), fragSrc.c_str());
+
+    next.program = glCreateProgram();
+    next.cached = LoadProgramBinary(ProgramCachePath(vertexPath, fragmentPath), next.key, next.program);
+    if (!next.cached)
+    {
+        // Nothing here waits on the driver: statuses are read in Finish, with parallel compile once it reports done
+        glDeleteProgram(next.program);
+        const char* vSrc = vertSrc.c_str();
+        const char* fSrc = fragSrc.c_str();
+
+        next.vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(next.vertex, 1, &vSrc, nullptr);
+        glCompileShader(next.vertex);
+
+        next.fragment = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(next.fragment, 1, &fSrc, nullptr);
+        glCompileShader(next.fragment);
+
+        next.program = glCreateProgram();
+        glProgramParameteri(next.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glAttachShader(next.program, next.vertex);
+        glAttachShader(next.program, next.fragment);
+        glLinkProgram(next.program);
+    }
+    pending = std::move(next);
+    return true;
+}
+
+bool Shader::Finish()
+{
+    if (!pending.program) return false;
+    if (!pending.cached)
+    {
+        GLint linked = GL_FALSE, length = 0;
+        glGetProgramiv(pending.program, GL_LINK_STATUS, &linked);
+        // A stage that failed explains the failed link better than the link log does
+        bool compiled = CheckStage(pending.vertex, pending.vertexPath);
+        compiled &= CheckStage(pending.fragment, pending.fragmentPath);
+        if (linked != GL_TRUE)
+        {
+            if (compiled)
+            {
+                glGetProgramiv(pending.program, GL_INFO_LOG_LENGTH, &length);
+                std::string log(std::max(length, 1), '\0');
+                glGetProgramInfoLog(pending.program, length, nullptr, log.data());
+                std::cerr << "Failed to link " << pending.vertexPath << " and " << pending.fragmentPath << ":\n" << log.c_str() << std::endl;
+            }
+            Discard();
+            return false;
+        }
+        SaveProgramBinary(ProgramCachePath(pending.vertexPath.c_str(), pending.fragmentPath.c_str()), pending.key, pending.program);
+        glDeleteShader(pending.vertex); glDeleteShader(pending.fragment); // Still attached, they go with the program
+    }
+
+    // Only a linked program replaces the current one
+    if (id) glDeleteProgram(id);
+    id = pending.program; glUseProgram(id);
+    vertexPath = std::move(pending.vertexPath); fragmentPath = std::move(pending.fragmentPath);
+    pending = PendingProgram();
+    Reflect();
+    return true;
+}
+
+void Shader::Discard()
+{
+    if (pending.vertex) glDeleteShader(pending.vertex);
+    if (pending.fragment) glDeleteShader(pending.fragment);
+    if (pending.program) glDeleteProgram(pending.program);
+    pending = PendingProgram();
 }
 
 Shader::~Shader()
 {
-    glDeleteProgram(id); glUseProgram(0);
+    Discard();
+    if (id) glDeleteProgram(id);
+    glUseProgram(0);
+}
+
+void Shader::Reflect()
+{
+    uniforms.clear(); blocks.clear();
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::string name(std::max(maxLength, 1), '\0');
+    for (GLint i = 0; i < count; i++)
+    {
+        GLsizei length = 0; GLint size = 0; GLenum type = 0;
+        glGetActiveUniform(id, GLuint(i), GLsizei(name.size()), &length, &size, &type, name.data());
+        std::string uniform(name.data(), length);
+        GLint location = glGetUniformLocation(id, uniform.c_str());
+        if (location < 0) continue; // Member of a uniform block
+        uniforms[uniform] = location;
+        // Arrays are reported as name[0], the bare name addresses the first element too
+        if (uniform.size() > 3 && uniform.compare(uniform.size() - 3, 3, "[0]") == 0) uniforms[uniform.substr(0, uniform.size() - 3)] = location;
+    }
+
+    glGetProgramiv(id, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+    glGetProgramiv(id, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+    name.assign(std::max(maxLength, 1), '\0');
+    for (GLint i = 0; i < count; i++)
+    {
+        GLsizei length = 0; GLint size = 0;
+        glGetActiveUniformBlockName(id, GLuint(i), GLsizei(name.size()), &length, name.data());
+        glGetActiveUniformBlockiv(id, GLuint(i), GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+        blocks[std::string(name.data(), length)] = size;
+    }
+}
+
+int Shader::Location(const char* name) const
+{
+    auto it = uniforms.find(name);
+    return it != uniforms.end() ? it->second : -1;
+}
+
+int Shader::BlockSize(const char* name) const
+{
+    auto it = blocks.find(name);
+    return it != blocks.end() ? it->second : 0;
 }
 
-void Shader::SetUniformMat4(const char* name, glm::mat4 mat)
+void Shader::SetUniformMat4(int location, const glm::mat4& mat)
 {
-    glUniformMatrix4fv(glGetUniformLocation(id, name), 1, GL_FALSE, value_ptr(mat));
+    glUniformMatrix4fv(location, 1, GL_FALSE, value_ptr(mat));
 }
-void Shader::SetUniformVec2(const char* name, glm::vec2 vector)
+void Shader::SetUniformVec2(int location, glm::vec2 vector)
 {
-    glUniform2f(glGetUniformLocation(id, name), vector.x, vector.y);
+    glUniform2f(location, vector.x, vector.y);
 }
-void Shader::SetUniformVec3(const char* name, glm::vec3 vector)
+void Shader::SetUniformVec3(int location, glm::vec3 vector)
 {
-    glUniform3f(glGetUniformLocation(id, name), vector.x, vector.y, vector.z);
+    glUniform3f(location, vector.x, vector.y, vector.z);
 }
-void Shader::SetUniformVec4(const char* name, glm::vec4 vector)
+void Shader::SetUniformVec4(int location, glm::vec4 vector)
 {
-    glUniform4f(glGetUniformLocation(id, name), vector.x, vector.y, vector.z, vector.w);
+    glUniform4f(location, vector.x, vector.y, vector.z, vector.w);
 }
-void Shader::SetUniform1f(const char* name, float f)
+void Shader::SetUniform1f(int location, float f)
 {
-    glUniform1f(glGetUniformLocation(id, name), f);
+    glUniform1f(location, f);
 }
-void Shader::SetUniform1i(const char* name, int slot)
+void Shader::SetUniform1i(int location, int slot)
 {
-    glUniform1i(glGetUniformLocation(id, name), slot);
+    glUniform1i(location, slot);
 }
\ No newline at end of file
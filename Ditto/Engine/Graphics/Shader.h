@@ -1,16 +1,77 @@
 #pragma once
 #include <cstdint>
+#include <string>
+#include <unordered_map>
 #include "../../3rdParty/GLM/glm.hpp"
 
+// Per-frame camera and light data, laid out as the std140 Frame block both shader stages declare. Scene writes it
+// into one uniform buffer per frame and binds it at FrameUniforms::binding, so a pass only binds the buffer instead of
+// setting each uniform.
+struct FrameUniforms
+{
+    static constexpr uint32_t binding = 0;
+    glm::mat4 view, projection;
+    glm::vec4 viewPos; // w unused
+    glm::vec4 lightColor; // w is the intensity
+    glm::vec4 lightDirection; // w unused
+};
+static_assert(sizeof(FrameUniforms) == 176, "FrameUniforms has to match the std140 Frame block");
+
+std::string ProgramCachePath(const char* vertexPath, const char* fragmentPath); // Cache/<vertex>_<fragment>.program beside the vertex shader
+
+// Active uniforms and uniform blocks are reflected once after linking. Location() resolves a name to a handle
+// that can be kept and passed to the setters, the name overloads look it up in the table and never ask GL.
+// A rebuild compiles into a pending program next to the current one, which keeps drawing until the new one
+// links; a rebuild that fails to compile or link is dropped.
 struct Shader
 {
-    uint32_t id;
+    static bool parallelCompile; // The driver compiles in the background and reports when it is done
+
+    uint32_t id = 0; // 0 until a program has linked
+    std::string vertexPath, fragmentPath; // Sources of id, Reload builds from them again
+    std::unordered_map<std::string, int> uniforms; // Active uniform -> location, block members excluded
+    std::unordered_map<std::string, int> blocks; // Active uniform block -> data size in bytes
+
     Shader(const char* vertexPath, const char* fragmentPath);
     ~Shader();
-	void SetUniformMat4(const char* name, glm::mat4 mat);
-	void SetUniformVec2(const char* name, glm::vec2 vector);
-	void SetUniformVec3(const char* name, glm::vec3 vector);
-	void SetUniformVec4(const char* name, glm::vec4 vector);
-	void SetUniform1f(const char* name, float f);
-	void SetUniform1i(const char* name, int slot);
-};
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
+    // Enables KHR or ARB_parallel_shader_compile when the driver has it, loadProc as passed to gladLoadGLLoader
+    static void EnableParallelCompile(void* (*loadProc)(const char* name));
+
+    // Builds from the sources, or from the program cache when they are unchanged, and waits for the result.
+    // Compile and link errors go to cerr and leave the current program in place.
+    bool Load(const char* vertexPath, const char* fragmentPath);
+    bool Reload(); // Starts a rebuild from vertexPath and fragmentPath without waiting, Update finishes it
+    bool Update(); // Once per frame: true when a pending rebuild finished and replaced the program
+    bool Pending() const { return pending.program != 0; }
+
+    int Location(const char* name) const; // -1 when the program has no such uniform, the setters ignore it like GL does
+    int BlockSize(const char* name) const; // 0 when the program has no such block
+
+	void SetUniformMat4(int location, const glm::mat4& mat);
+	void SetUniformVec2(int location, glm::vec2 vector);
+	void SetUniformVec3(int location, glm::vec3 vector);
+	void SetUniformVec4(int location, glm::vec4 vector);
+	void SetUniform1f(int location, float f);
+	void SetUniform1i(int location, int slot);
+	void SetUniformMat4(const char* name, const glm::mat4& mat) { SetUniformMat4(Location(name), mat); }
+	void SetUniformVec2(const char* name, glm::vec2 vector) { SetUniformVec2(Location(name), vector); }
+	void SetUniformVec3(const char* name, glm::vec3 vector) { SetUniformVec3(Location(name), vector); }
+	void SetUniformVec4(const char* name, glm::vec4 vector) { SetUniformVec4(Location(name), vector); }
+	void SetUniform1f(const char* name, float f) { SetUniform1f(Location(name), f); }
+	void SetUniform1i(const char* name, int slot) { SetUniform1i(Location(name), slot); }
+
+private:
+    struct PendingProgram
+    {
+        uint32_t program = 0, vertex = 0, fragment = 0; // Stages are 0 when the program came from the cache
+        uint64_t key = 0; bool cached = false;
+        std::string vertexPath, fragmentPath;
+    } pending;
+
+    bool Begin(const char* vertexPath, const char* fragmentPath); // Issues the compile and link, fails only on unreadable sources
+    bool Finish(); // Reads the statuses, blocking unless the driver reported completion, and swaps on success
+    void Discard();
+    void Reflect();
+};
\ No newline at end of file
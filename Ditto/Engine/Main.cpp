@@ -1,7 +1,45 @@
 #include "Core/Engine.h"
+#include "Core/TransformBatch.h"
+#include "Resources/Resource.h"
+#include <string>
+#include <cstdlib>
 
-int main()
+int main(int argc, char** argv)
 {
+	// Ditto --headless [scene.bin] [frames]: tick the scene without a window, GL context or editor
+	if (argc > 1 && std::string(argv[1]) == "--headless")
+	{
+		Engine* engine = new Engine(true);
+		bool succeeded = engine->RunHeadless(argc > 2 ? argv[2] : "Assets/Scenes/scene.bin", argc > 3 ? std::atoi(argv[3]) : 600);
+		delete engine;
+		return succeeded ? 0 : 1;
+	}
+
+	// Ditto --cook model.obj...: parse each OBJ and write its cooked .mesh next to it
+	if (argc > 1 && std::string(argv[1]) == "--cook")
+	{
+		bool succeeded = true;
+		for (int i = 2; i < argc; i++)
+		{
+			ModelData model; MeshData mesh;
+			succeeded &= LoadOBJ(argv[i], &model, &mesh) && CookMesh(CookedMeshPath(argv[i]), model, mesh);
+		}
+		return succeeded ? 0 : 1;
+	}
+
+	// Ditto --check-stacking [bodies]: settle two layers of bodies on each other, fails if a step stalls or a body sinks
+	if (argc > 1 && std::string(argv[1]) == "--check-stacking")
+	{
+		Engine* engine = new Engine(true);
+		bool succeeded = engine->CheckStacking(argc > 2 ? std::atoi(argv[2]) : 2000);
+		delete engine;
+		return succeeded ? 0 : 1;
+	}
+
+	// Ditto --bench-transforms [count]: per-transform cost of building model matrices, one at a time and batched
+	if (argc > 1 && std::string(argv[1]) == "--bench-transforms")
+		return BenchmarkTransforms(argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100000) ? 0 : 1;
+
 	Engine* engine = new Engine();
 	engine->Run();
 }
\ No newline at end of file
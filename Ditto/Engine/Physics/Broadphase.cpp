@@ -0,0 +1,225 @@
+#include "Broadphase.h"
+#include <algorithm>
+
+void Broadphase::Clear()
+{
+    nodes.clear(); pairs.clear(); moveBuffer.clear(); persistentPairs.clear();
+    root = freeList = nullNode;
+}
+
+int Broadphase::CreateProxy(const AABB& bound, int userData)
+{
+    int proxyId = AllocateNode();
+    nodes[proxyId].bound = { bound.min - glm::vec3(margin), bound.max + glm::vec3(margin) };
+    nodes[proxyId].userData = userData; nodes[proxyId].height = 0;
+    InsertLeaf(proxyId);
+
+    nodes[proxyId].moved = true; moveBuffer.push_back(proxyId);
+    return proxyId;
+}
+
+void Broadphase::DestroyProxy(int proxyId)
+{
+    if (nodes[proxyId].moved) moveBuffer.erase(std::find(moveBuffer.begin(), moveBuffer.end(), proxyId));
+    RemoveLeaf(proxyId);
+    FreeNode(proxyId);
+}
+
+bool Broadphase::MoveProxy(int proxyId, const AABB& bound, const glm::vec3& displacement)
+{
+    if (nodes[proxyId].bound.Contains(bound)) return false;
+
+    RemoveLeaf(proxyId);
+
+    // Extend the fat bound along the predicted motion so fast bodies are reinserted less often
+    AABB fatBound = { bound.min - glm::vec3(margin), bound.max + glm::vec3(margin) };
+    glm::vec3 predicted = displacement * predictMultiplier;
+    for (int i = 0; i < 3; i++)
+    {
+        if (predicted[i] < 0) fatBound.min[i] += predicted[i];
+        else fatBound.max[i] += predicted[i];
+    }
+    nodes[proxyId].bound = fatBound;
+    InsertLeaf(proxyId);
+
+    if (!nodes[proxyId].moved) { nodes[proxyId].moved = true; moveBuffer.push_back(proxyId); }
+    return true;
+}
+
+void Broadphase::UpdatePairs()
+{
+    // Pairs between two proxies whose fat bounds did not change are still valid, everything else is re-queried
+    persistentPairs.clear();
+    for (const Pair& pair : pairs)
+    {
+        const Node& a = nodes[pair.proxyA]; const Node& b = nodes[pair.proxyB];
+        if (a.userData < 0 || b.userData < 0 || a.moved || b.moved) continue;
+        persistentPairs.push_back(pair);
+    }
+    pairs.swap(persistentPairs);
+
+    for (int queryId : moveBuffer)
+    {
+        if (nodes[queryId].userData < 0) continue;
+        Query(nodes[queryId].bound, [&](int proxyId)
+        {
+            if (proxyId == queryId) return;
+            if (nodes[proxyId].moved && proxyId > queryId) return; // Both moved, the other query reports it
+            pairs.push_back({ std::min(proxyId, queryId), std::max(proxyId, queryId) });
+        });
+    }
+
+    for (int proxyId : moveBuffer) nodes[proxyId].moved = false;
+    moveBuffer.clear();
+}
+
+int Broadphase::AllocateNode()
+{
+    int index;
+    if (freeList == nullNode) { index = static_cast<int>(nodes.size()); nodes.emplace_back(); }
+    else { index = freeList; freeList = nodes[index].parent; }
+
+    Node& node = nodes[index];
+    node.parent = node.left = node.right = nullNode;
+    node.height = 0; node.userData = -1; node.moved = false;
+    return index;
+}
+
+void Broadphase::FreeNode(int index)
+{
+    nodes[index].parent = freeList; nodes[index].height = -1; nodes[index].userData = -1; nodes[index].moved = false;
+    freeList = index;
+}
+
+void Broadphase::InsertLeaf(int leaf)
+{
+    if (root == nullNode) { root = leaf; nodes[root].parent = nullNode; return; }
+
+    // Descend along the cheapest surface area heuristic path to find the best sibling
+    AABB leafBound = nodes[leaf].bound;
+    int index = root;
+    while (!nodes[index].IsLeaf())
+    {
+        const Node& node = nodes[index];
+        float area = node.bound.SurfaceArea();
+        float combinedArea = AABB::Union(node.bound, leafBound).SurfaceArea();
+        float cost = 2.0f * combinedArea, inheritance = 2.0f * (combinedArea - area);
+
+        auto ChildCost = [&](int child)
+        {
+            float unionArea = AABB::Union(leafBound, nodes[child].bound).SurfaceArea();
+            return (nodes[child].IsLeaf() ? unionArea : unionArea - nodes[child].bound.SurfaceArea()) + inheritance;
+        };
+        float leftCost = ChildCost(node.left), rightCost = ChildCost(node.right);
+
+        if (cost < leftCost && cost < rightCost) break;
+        index = leftCost < rightCost ? node.left : node.right;
+    }
+
+    int sibling = index, oldParent = nodes[sibling].parent;
+    int newParent = AllocateNode();
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].bound = AABB::Union(leafBound, nodes[sibling].bound);
+    nodes[newParent].height = nodes[sibling].height + 1;
+    nodes[newParent].left = sibling; nodes[newParent].right = leaf;
+    nodes[sibling].parent = newParent; nodes[leaf].parent = newParent;
+
+    if (oldParent == nullNode) root = newParent;
+    else if (nodes[oldParent].left == sibling) nodes[oldParent].left = newParent;
+    else nodes[oldParent].right = newParent;
+
+    Refit(nodes[leaf].parent);
+}
+
+void Broadphase::RemoveLeaf(int leaf)
+{
+    if (leaf == root) { root = nullNode; return; }
+
+    int parent = nodes[leaf].parent, grandParent = nodes[parent].parent;
+    int sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+
+    if (grandParent == nullNode) { root = sibling; nodes[sibling].parent = nullNode; FreeNode(parent); return; }
+
+    if (nodes[grandParent].left == parent) nodes[grandParent].left = sibling;
+    else nodes[grandParent].right = sibling;
+    nodes[sibling].parent = grandParent;
+    FreeNode(parent);
+
+    Refit(grandParent);
+}
+
+void Broadphase::Refit(int index)
+{
+    while (index != nullNode)
+    {
+        index = Balance(index);
+        Node& node = nodes[index];
+        node.height = 1 + std::max(nodes[node.left].height, nodes[node.right].height);
+        node.bound = AABB::Union(nodes[node.left].bound, nodes[node.right].bound);
+        index = node.parent;
+    }
+}
+
+int Broadphase::Balance(int iA)
+{
+    Node& A = nodes[iA];
+    if (A.IsLeaf() || A.height < 2) return iA;
+
+    int iB = A.left, iC = A.right;
+    Node& B = nodes[iB]; Node& C = nodes[iC];
+    int balance = C.height - B.height;
+
+    // Rotate C up
+    if (balance > 1)
+    {
+        int iF = C.left, iG = C.right;
+        Node& F = nodes[iF]; Node& G = nodes[iG];
+
+        C.left = iA; C.parent = A.parent; A.parent = iC;
+        if (C.parent == nullNode) root = iC;
+        else if (nodes[C.parent].left == iA) nodes[C.parent].left = iC;
+        else nodes[C.parent].right = iC;
+
+        if (F.height > G.height)
+        {
+            C.right = iF; A.right = iG; G.parent = iA;
+            A.bound = AABB::Union(B.bound, G.bound); C.bound = AABB::Union(A.bound, F.bound);
+            A.height = 1 + std::max(B.height, G.height); C.height = 1 + std::max(A.height, F.height);
+        }
+        else
+        {
+            C.right = iG; A.right = iF; F.parent = iA;
+            A.bound = AABB::Union(B.bound, F.bound); C.bound = AABB::Union(A.bound, G.bound);
+            A.height = 1 + std::max(B.height, F.height); C.height = 1 + std::max(A.height, G.height);
+        }
+        return iC;
+    }
+
+    // Rotate B up
+    if (balance < -1)
+    {
+        int iD = B.left, iE = B.right;
+        Node& D = nodes[iD]; Node& E = nodes[iE];
+
+        B.left = iA; B.parent = A.parent; A.parent = iB;
+        if (B.parent == nullNode) root = iB;
+        else if (nodes[B.parent].left == iA) nodes[B.parent].left = iB;
+        else nodes[B.parent].right = iB;
+
+        if (D.height > E.height)
+        {
+            B.right = iD; A.left = iE; E.parent = iA;
+            A.bound = AABB::Union(C.bound, E.bound); B.bound = AABB::Union(A.bound, D.bound);
+            A.height = 1 + std::max(C.height, E.height); B.height = 1 + std::max(A.height, D.height);
+        }
+        else
+        {
+            B.right = iE; A.left = iD; D.parent = iA;
+            A.bound = AABB::Union(C.bound, D.bound); B.bound = AABB::Union(A.bound, E.bound);
+            A.height = 1 + std::max(C.height, D.height); B.height = 1 + std::max(A.height, E.height);
+        }
+        return iB;
+    }
+
+    return iA;
+}
\ No newline at end of file
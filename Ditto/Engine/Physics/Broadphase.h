@@ -0,0 +1,71 @@
+#pragma once
+#include <vector>
+#include "../../3rdParty/GLM/glm.hpp"
+
+struct AABB
+{
+	glm::vec3 min, max;
+
+	bool Overlaps(const AABB& other) const
+	{
+		return max.x >= other.min.x && min.x <= other.max.x && max.y >= other.min.y && min.y <= other.max.y && max.z >= other.min.z && min.z <= other.max.z;
+	}
+	bool Contains(const AABB& other) const
+	{
+		return min.x <= other.min.x && min.y <= other.min.y && min.z <= other.min.z && max.x >= other.max.x && max.y >= other.max.y && max.z >= other.max.z;
+	}
+	float SurfaceArea() const { glm::vec3 d = max - min; return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x); }
+	static AABB Union(const AABB& a, const AABB& b) { return { glm::min(a.min, b.min), glm::max(a.max, b.max) }; }
+};
+
+// Dynamic AABB tree over fattened leaf bounds. A proxy is only reinserted when its tight bound leaves
+// its fat bound, and overlapping pairs persist until one of their proxies moves again.
+struct Broadphase
+{
+	static const int nullNode = -1;
+	struct Node
+	{
+		AABB bound; int parent, left, right, height, userData; bool moved;
+		bool IsLeaf() const { return left == nullNode; }
+	};
+	struct Pair { int proxyA, proxyB; };
+
+	std::vector<Node> nodes;
+	std::vector<Pair> pairs;
+	int root = nullNode, freeList = nullNode;
+	float margin = 0.1f, predictMultiplier = 2.0f;
+
+	void Clear();
+	int CreateProxy(const AABB& bound, int userData);
+	void DestroyProxy(int proxyId);
+	bool MoveProxy(int proxyId, const AABB& bound, const glm::vec3& displacement);
+	void UpdatePairs();
+	int GetUserData(int proxyId) const { return nodes[proxyId].userData; }
+	const AABB& GetFatBound(int proxyId) const { return nodes[proxyId].bound; }
+
+	template<typename F>
+	void Query(const AABB& bound, F callback)
+	{
+		if (root == nullNode) return;
+		queryStack.clear(); queryStack.push_back(root);
+		while (!queryStack.empty())
+		{
+			int index = queryStack.back(); queryStack.pop_back();
+			const Node& node = nodes[index];
+			if (!node.bound.Overlaps(bound)) continue;
+			if (node.IsLeaf()) callback(index);
+			else { queryStack.push_back(node.left); queryStack.push_back(node.right); }
+		}
+	}
+
+private:
+	std::vector<int> moveBuffer, queryStack;
+	std::vector<Pair> persistentPairs;
+
+	int AllocateNode();
+	void FreeNode(int index);
+	void InsertLeaf(int leaf);
+	void RemoveLeaf(int leaf);
+	int Balance(int index);
+	void Refit(int index);
+};
\ No newline at end of file
@@ -0,0 +1,175 @@
+#include "Narrowphase.h"
+#include "Physics.h"
+#include <algorithm>
+
+static bool SameDirection(const glm::vec3& a, const glm::vec3& b) { return glm::dot(a, b) > 0; }
+
+SupportPoint Narrowphase::Support(const Collider& a, const Collider& b, const glm::vec3& direction)
+{
+    SupportPoint support;
+    support.a = a.Support(direction, &hintA);
+    support.b = b.Support(-direction, &hintB);
+    support.point = support.a - support.b;
+    return support;
+}
+
+bool Narrowphase::GJK(const Collider& a, const Collider& b)
+{
+    glm::vec3 direction = (a.bound.min + a.bound.max) - (b.bound.min + b.bound.max);
+    if (glm::dot(direction, direction) < 1e-12f) direction = glm::vec3(1, 0, 0);
+
+    hintA = hintB = 0;
+    simplex[0] = Support(a, b, direction); simplexSize = 1;
+    direction = -simplex[0].point;
+
+    for (int i = 0; i < maxIterations; i++)
+    {
+        // Origin lies on the current simplex: the shapes only touch, there is nothing to resolve
+        if (glm::dot(direction, direction) < 1e-12f) return false;
+
+        SupportPoint support = Support(a, b, direction);
+        if (glm::dot(support.point, direction) <= 0) return false;
+
+        for (int j = simplexSize; j > 0; j--) simplex[j] = simplex[j - 1];
+        simplex[0] = support; simplexSize++;
+
+        if (NextSimplex(direction)) return true;
+    }
+    return false;
+}
+
+bool Narrowphase::NextSimplex(glm::vec3& direction)
+{
+    switch (simplexSize)
+    {
+    case 2: return Line(direction);
+    case 3: return Triangle(direction);
+    case 4: return Tetrahedron(direction);
+    }
+    return false;
+}
+
+bool Narrowphase::Line(glm::vec3& direction)
+{
+    glm::vec3 ab = simplex[1].point - simplex[0].point, ao = -simplex[0].point;
+
+    if (SameDirection(ab, ao)) direction = glm::cross(glm::cross(ab, ao), ab);
+    else { simplexSize = 1; direction = ao; }
+    return false;
+}
+
+bool Narrowphase::Triangle(glm::vec3& direction)
+{
+    SupportPoint a = simplex[0], b = simplex[1], c = simplex[2];
+    glm::vec3 ab = b.point - a.point, ac = c.point - a.point, ao = -a.point;
+    glm::vec3 abc = glm::cross(ab, ac);
+
+    if (SameDirection(glm::cross(abc, ac), ao))
+    {
+        if (SameDirection(ac, ao)) { simplex[1] = c; simplexSize = 2; direction = glm::cross(glm::cross(ac, ao), ac); return false; }
+        simplexSize = 2; return Line(direction);
+    }
+    if (SameDirection(glm::cross(ab, abc), ao)) { simplexSize = 2; return Line(direction); }
+
+    if (SameDirection(abc, ao)) direction = abc;
+    else { simplex[1] = c; simplex[2] = b; direction = -abc; }
+    return false;
+}
+
+bool Narrowphase::Tetrahedron(glm::vec3& direction)
+{
+    SupportPoint a = simplex[0], b = simplex[1], c = simplex[2], d = simplex[3];
+    glm::vec3 ab = b.point - a.point, ac = c.point - a.point, ad = d.point - a.point, ao = -a.point;
+
+    if (SameDirection(glm::cross(ab, ac), ao)) { simplexSize = 3; return Triangle(direction); }
+    if (SameDirection(glm::cross(ac, ad), ao)) { simplex[1] = c; simplex[2] = d; simplexSize = 3; return Triangle(direction); }
+    if (SameDirection(glm::cross(ad, ab), ao)) { simplex[1] = d; simplex[2] = b; simplexSize = 3; return Triangle(direction); }
+    return true;
+}
+
+bool Narrowphase::EPA(const Collider& a, const Collider& b, Contact& contact)
+{
+    // Wind the tetrahedron so every face below points away from the vertex it leaves out. From here on faces are
+    // only added from horizon edges, which keeps that winding, so none is ever flipped.
+    polytope.assign(simplex, simplex + 4);
+    glm::vec3 base = polytope[0].point;
+    float volume = glm::dot(glm::cross(polytope[1].point - base, polytope[2].point - base), polytope[3].point - base);
+    if (std::abs(volume) < 1e-12f) return false; // Flat simplex: the origin is on its surface, the shapes only touch
+    if (volume > 0) std::swap(polytope[1], polytope[2]);
+    faces.clear();
+    if (!AddFace(0, 1, 2) || !AddFace(0, 3, 1) || !AddFace(0, 2, 3) || !AddFace(1, 3, 2)) return false;
+
+    Face closest;
+    for (int iteration = 0; iteration < maxIterations; iteration++)
+    {
+        closest = faces[0];
+        for (const Face& face : faces) if (face.distance < closest.distance) closest = face;
+
+        glm::vec3 normal = closest.normal;
+        SupportPoint support = Support(a, b, normal);
+        if (glm::dot(support.point, normal) - closest.distance < tolerance) break;
+        // A closed polytope has at most 2V - 4 faces, past the cap something went wrong and the closest face is kept
+        if (static_cast<int>(faces.size()) > maxFaces) break;
+
+        // Remove every face the new point can see and stitch the horizon to it
+        int newIndex = static_cast<int>(polytope.size());
+        polytope.push_back(support);
+        edges.clear();
+        for (size_t i = 0; i < faces.size();)
+        {
+            const Face& face = faces[i];
+            if (SameDirection(face.normal, support.point - polytope[face.v[0]].point))
+            {
+                AddEdge(face.v[0], face.v[1]); AddEdge(face.v[1], face.v[2]); AddEdge(face.v[2], face.v[0]);
+                faces[i] = faces.back(); faces.pop_back();
+            }
+            else i++;
+        }
+
+        // A degenerate new face or one behind the origin would leave the polytope open, stop at the last closest face
+        bool closed = !edges.empty();
+        for (const auto& edge : edges) if (closed) closed = AddFace(edge.first, edge.second, newIndex);
+        if (!closed) break;
+    }
+
+    // Barycentric coordinates of the origin's projection on the closest face give the witness points
+    const Face& face = closest;
+    const SupportPoint& p0 = polytope[face.v[0]]; const SupportPoint& p1 = polytope[face.v[1]]; const SupportPoint& p2 = polytope[face.v[2]];
+    glm::vec3 projected = face.normal * face.distance;
+    glm::vec3 v0 = p1.point - p0.point, v1 = p2.point - p0.point, v2 = projected - p0.point;
+    float d00 = glm::dot(v0, v0), d01 = glm::dot(v0, v1), d11 = glm::dot(v1, v1), d20 = glm::dot(v2, v0), d21 = glm::dot(v2, v1);
+    float denominator = d00 * d11 - d01 * d01;
+    float v = 0, w = 0;
+    if (std::abs(denominator) > 1e-12f) { v = (d11 * d20 - d01 * d21) / denominator; w = (d00 * d21 - d01 * d20) / denominator; }
+    float u = 1.0f - v - w;
+
+    contact.normal = face.normal;
+    contact.depth = face.distance;
+    contact.pointA = u * p0.a + v * p1.a + w * p2.a;
+    contact.pointB = u * p0.b + v * p1.b + w * p2.b;
+    return contact.depth > 0;
+}
+
+bool Narrowphase::AddFace(int a, int b, int c)
+{
+    glm::vec3 pa = polytope[a].point;
+    glm::vec3 normal = glm::cross(polytope[b].point - pa, polytope[c].point - pa);
+    float length = glm::length(normal);
+    if (length < 1e-10f) return false;
+
+    Face face = { { a, b, c }, normal / length, 0 };
+    face.distance = glm::dot(face.normal, pa);
+    if (face.distance < -tolerance) return false;
+    faces.push_back(face);
+    return true;
+}
+
+void Narrowphase::AddEdge(int a, int b)
+{
+    // An edge shared by two removed faces is interior, only the horizon edges survive
+    for (size_t i = 0; i < edges.size(); i++)
+    {
+        if (edges[i].first == b && edges[i].second == a) { edges[i] = edges.back(); edges.pop_back(); return; }
+    }
+    edges.emplace_back(a, b);
+}
\ No newline at end of file
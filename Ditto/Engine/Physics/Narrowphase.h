@@ -0,0 +1,48 @@
+#pragma once
+#include <vector>
+#include "../../3rdParty/GLM/glm.hpp"
+
+struct Collider;
+
+struct SupportPoint
+{
+	glm::vec3 point, a, b; // Minkowski difference point and the witness points on each shape
+};
+
+struct Contact
+{
+	int a, b;
+	glm::vec3 normal, pointA, pointB; // Normal points from a to b
+	float depth;
+};
+
+// GJK intersection test and EPA penetration solver over Collider support mappings.
+// Scratch buffers are kept between calls so contact generation does not allocate once warmed up. They make an
+// instance single threaded, parallel contact generation uses one per thread.
+struct Narrowphase
+{
+	int maxIterations = 64;
+	int maxFaces = 256; // EPA backstop, 64 iterations on a closed polytope stay well below it
+	float tolerance = 1e-4f;
+
+	bool GJK(const Collider& a, const Collider& b);
+	bool EPA(const Collider& a, const Collider& b, Contact& contact);
+	bool Collide(const Collider& a, const Collider& b, Contact& contact) { return GJK(a, b) && EPA(a, b, contact); }
+
+private:
+	struct Face { int v[3]; glm::vec3 normal; float distance; };
+
+	SupportPoint simplex[4]; int simplexSize = 0;
+	int hintA = 0, hintB = 0; // Hull support search starts, kept per query so colliders stay read-only
+	std::vector<SupportPoint> polytope;
+	std::vector<Face> faces;
+	std::vector<std::pair<int, int>> edges;
+
+	SupportPoint Support(const Collider& a, const Collider& b, const glm::vec3& direction);
+	bool NextSimplex(glm::vec3& direction);
+	bool Line(glm::vec3& direction);
+	bool Triangle(glm::vec3& direction);
+	bool Tetrahedron(glm::vec3& direction);
+	bool AddFace(int a, int b, int c);
+	void AddEdge(int a, int b);
+};
\ No newline at end of file
@@ -1 +1,295 @@
 #include "Physics.h"
+#include <cmath>
+#include <algorithm>
+#include <iterator>
+#include "../Core/TransformBatch.h"
+
+void Physics::GenerateColliders(ComponentStore& components, Resource* resource)
+{
+    colliders.clear(); broadphase.Clear(); candidatePairs.clear();
+    ComponentPool<RigidbodyComponent>& rigidbodies = components.Pool<RigidbodyComponent>();
+    colliders.reserve(rigidbodies.Size());
+    for (size_t i = 0; i < rigidbodies.Size(); i++)
+    {
+        uint32_t entity = rigidbodies.entities[i];
+        Collider collider;
+        collider.transform = components.Pool<TransformComponent>().Get(entity);
+        collider.renderer = components.Pool<RendererComponent>().Get(entity);
+        collider.rigidbody = &rigidbodies.dense[i];
+        if (!collider.transform) continue;
+        collider.mesh = nullptr; collider.shape = Collider::Box;
+
+        if (collider.renderer)
+        {
+            // The built-in cube and sphere have analytic supports, every other mesh is treated as its convex hull
+            MeshHandle mesh = resource->Resolve(collider.renderer->mesh, collider.renderer->meshHandle);
+            collider.mesh = resource->GetMeshData(mesh);
+            collider.shape = mesh == resource->cube ? Collider::Box : mesh == resource->sphere ? Collider::Sphere : Collider::Hull;
+        }
+        if (collider.shape == Collider::Hull && (!collider.mesh || collider.mesh->vertices.empty())) collider.shape = Collider::Box;
+        if (collider.mesh && !collider.mesh->vertices.empty()) collider.localBound = { collider.mesh->aabbMin, collider.mesh->aabbMax };
+        else collider.localBound = { glm::vec3(-0.5f), glm::vec3(0.5f) };
+
+        collider.UpdateBound();
+        collider.proxyId = broadphase.CreateProxy(collider.bound, static_cast<int>(colliders.size()));
+        colliders.push_back(collider);
+    }
+    collidersDirty = false; colliderVersion = components.version; meshVersion = resource->meshVersion;
+}
+
+void Physics::UpdatePhysics()
+{
+    UpdateKinematic();
+    IntegrateForce();
+    DetectCollisions();
+    ResolveContacts();
+    IntegrateVelocity();
+    UpdateBounds();
+    HandleBoardCollisions();
+    UpdateBroadphase();
+}
+
+// Per-body steps touch only their own collider, rigidbody and transform, so they split into ranges of this many colliders
+const size_t bodyGrain = 1024;
+const size_t pairGrain = 256;
+
+void Physics::IntegrateForce()
+{
+    Jobs().ParallelFor(colliders.size(), bodyGrain, [this](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            Collider& collider = colliders[i];
+            if (!collider.IsDynamic()) continue;
+            RigidbodyComponent* rigidbody = collider.rigidbody;
+
+            if (rigidbody->useGravity) rigidbody->velocity += gravity * dt;
+            rigidbody->velocity *= 1.0f / (1.0f + dt * rigidbody->damp);
+            rigidbody->angularVelocity *= 1.0f / (1.0f + dt * rigidbody->angularDamp);
+        }
+    });
+}
+
+void Physics::DetectCollisions()
+{
+    // Pair ranges only read colliders; each writes its own contact list so the merged order matches a serial pass
+    JobSystem& jobSystem = Jobs();
+    narrowphases.resize(jobSystem.ThreadCount());
+    rangeContacts.resize((candidatePairs.size() + pairGrain - 1) / pairGrain);
+    jobSystem.ParallelFor(candidatePairs.size(), pairGrain, [this, &jobSystem](size_t begin, size_t end)
+    {
+        Narrowphase& narrowphase = narrowphases[jobSystem.ThreadIndex()];
+        std::vector<Contact>& found = rangeContacts[begin / pairGrain];
+        found.clear();
+        for (size_t i = begin; i < end; i++)
+        {
+            const auto& pair = candidatePairs[i];
+            const Collider& a = colliders[pair.first]; const Collider& b = colliders[pair.second];
+            if (!a.bound.Overlaps(b.bound)) continue;
+
+            Contact contact;
+            if (!narrowphase.Collide(a, b, contact)) continue;
+            contact.a = pair.first; contact.b = pair.second;
+            found.push_back(contact);
+        }
+    });
+
+    contacts.clear();
+    for (const std::vector<Contact>& found : rangeContacts) contacts.insert(contacts.end(), found.begin(), found.end());
+}
+
+void Physics::ResolveContacts()
+{
+    // Sequential impulses on the linear velocities, then a single split of the remaining penetration by inverse mass
+    for (int iteration = 0; iteration < solverIterations; iteration++)
+    {
+        for (const Contact& contact : contacts)
+        {
+            Collider& a = colliders[contact.a]; Collider& b = colliders[contact.b];
+            float inverseMassA = a.InverseMass(), inverseMassB = b.InverseMass(), inverseMassSum = inverseMassA + inverseMassB;
+            if (inverseMassSum <= 0) continue;
+
+            glm::vec3 velocityA = a.IsDynamic() ? a.rigidbody->velocity : glm::vec3(0), velocityB = b.IsDynamic() ? b.rigidbody->velocity : glm::vec3(0);
+            glm::vec3 relative = velocityB - velocityA;
+            float normalSpeed = glm::dot(relative, contact.normal);
+            if (normalSpeed >= 0) continue;
+
+            float bounce = -normalSpeed > restSpeed ? restitution : 0.0f;
+            glm::vec3 impulse = contact.normal * (-(1.0f + bounce) * normalSpeed / inverseMassSum);
+
+            glm::vec3 tangent = relative - contact.normal * normalSpeed;
+            float tangentSpeed = glm::length(tangent);
+            if (tangentSpeed > 1e-6f)
+            {
+                float frictionImpulse = std::min(tangentSpeed / inverseMassSum, friction * glm::length(impulse));
+                impulse -= tangent / tangentSpeed * frictionImpulse;
+            }
+
+            if (a.IsDynamic()) a.rigidbody->velocity -= impulse * inverseMassA;
+            if (b.IsDynamic()) b.rigidbody->velocity += impulse * inverseMassB;
+        }
+    }
+
+    const float slop = 0.005f, correctionPercent = 0.8f;
+    for (const Contact& contact : contacts)
+    {
+        Collider& a = colliders[contact.a]; Collider& b = colliders[contact.b];
+        float inverseMassA = a.InverseMass(), inverseMassB = b.InverseMass(), inverseMassSum = inverseMassA + inverseMassB;
+        if (inverseMassSum <= 0 || contact.depth <= slop) continue;
+
+        glm::vec3 correction = contact.normal * ((contact.depth - slop) * correctionPercent / inverseMassSum);
+        for (int i = 0; i < 3; i++)
+        {
+            a.transform->position[i] -= correction[i] * inverseMassA;
+            b.transform->position[i] += correction[i] * inverseMassB;
+        }
+    }
+}
+
+void Physics::IntegrateVelocity()
+{
+    Jobs().ParallelFor(colliders.size(), bodyGrain, [this](size_t begin, size_t end)
+    {
+        // Moved transforms are composed in batches by the vector kernel rather than one ComputeModel each
+        TransformComponent* moved[64]; size_t movedCount = 0;
+        for (size_t c = begin; c < end; c++)
+        {
+            Collider& collider = colliders[c];
+            if (!collider.IsDynamic()) continue;
+            RigidbodyComponent* rigidbody = collider.rigidbody;
+            TransformComponent* transform = collider.transform;
+
+            for (int i = 0; i < 3; i++) transform->position[i] += rigidbody->velocity[i] * dt;
+
+            float angle = glm::length(rigidbody->angularVelocity) * dt;
+            if (angle > 1e-6f)
+            {
+                // Angular velocity is in world space, so the delta rotation is applied on the left
+                transform->rotation = glm::normalize(glm::angleAxis(angle, glm::normalize(rigidbody->angularVelocity)) * transform->rotation);
+            }
+
+            moved[movedCount++] = transform;
+            if (movedCount == std::size(moved)) { ComputeModels(moved, movedCount); movedCount = 0; }
+        }
+        ComputeModels(moved, movedCount);
+    });
+    MarkMoved();
+}
+
+void Physics::UpdateBounds()
+{
+    Jobs().ParallelFor(colliders.size(), bodyGrain, [this](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++) if (colliders[i].IsDynamic()) colliders[i].UpdateBound();
+    });
+}
+
+void Physics::UpdateKinematic()
+{
+    // Parented bodies were moved by UpdateHierarchy before the step, their bounds and proxies follow the new world matrix
+    for (Collider& collider : colliders)
+    {
+        if (!collider.IsKinematic()) continue;
+        AABB previous = collider.bound;
+        collider.UpdateBound();
+        if (collider.bound.min == previous.min && collider.bound.max == previous.max) continue;
+        glm::vec3 displacement = (collider.bound.min + collider.bound.max - previous.min - previous.max) * 0.5f;
+        broadphase.MoveProxy(collider.proxyId, collider.bound, displacement);
+    }
+}
+
+void Physics::MarkMoved()
+{
+    // The dirty lists are shared by every entity, so marking stays on the calling thread after the parallel part
+    for (Collider& collider : colliders)
+    {
+        TransformComponent* transform = collider.transform;
+        if (collider.IsDynamic() && transform->gameObject) transform->gameObject->store->MarkDirty(transform->gameObject->id, TransformComponent::Mask);
+    }
+}
+
+void Physics::UpdateBroadphase()
+{
+    for (Collider& collider : colliders)
+        if (collider.IsDynamic()) broadphase.MoveProxy(collider.proxyId, collider.bound, collider.rigidbody->velocity * dt);
+    broadphase.UpdatePairs();
+
+    candidatePairs.clear();
+    for (const Broadphase::Pair& pair : broadphase.pairs)
+    {
+        int a = broadphase.GetUserData(pair.proxyA), b = broadphase.GetUserData(pair.proxyB);
+        if (colliders[a].IsDynamic() || colliders[b].IsDynamic()) candidatePairs.emplace_back(a, b);
+    }
+}
+
+void Physics::HandleBoardCollisions()
+{
+    // Only dynamic bodies are pushed back and IntegrateVelocity already marked all of them moved this step
+    Jobs().ParallelFor(colliders.size(), bodyGrain, [this](size_t begin, size_t end)
+    {
+        for (size_t c = begin; c < end; c++)
+        {
+            Collider& collider = colliders[c];
+            if (!collider.IsDynamic()) continue;
+            RigidbodyComponent* rigidbody = collider.rigidbody;
+            TransformComponent* transform = collider.transform;
+
+            bool moved = false;
+            for (int axis = 0; axis < 3; axis++)
+            {
+                float push = 0;
+                if (collider.bound.min[axis] < boardMin[axis]) push = boardMin[axis] - collider.bound.min[axis];
+                else if (collider.bound.max[axis] > boardMax[axis]) push = boardMax[axis] - collider.bound.max[axis];
+                if (push == 0) continue;
+
+                transform->position[axis] += push; moved = true;
+                collider.bound.min[axis] += push; collider.bound.max[axis] += push;
+
+                // Reflect the velocity component going into the wall and damp the tangential ones
+                if (rigidbody->velocity[axis] * push < 0) rigidbody->velocity[axis] *= -restitution;
+                if (std::abs(rigidbody->velocity[axis]) < restSpeed) rigidbody->velocity[axis] = 0;
+                for (int tangent = 0; tangent < 3; tangent++) if (tangent != axis) rigidbody->velocity[tangent] *= 1.0f - friction;
+                rigidbody->angularVelocity *= 1.0f - friction;
+            }
+            if (moved) transform->ComputeModel();
+        }
+    });
+}
+
+glm::vec3 Collider::Support(const glm::vec3& direction, int* hint) const
+{
+    // The support of M * shape along d is M applied to the local support along M^T d
+    const glm::mat4& model = transform->model;
+    glm::vec3 localDirection = glm::transpose(glm::mat3(model)) * direction, localPoint;
+    glm::vec3 center = (localBound.min + localBound.max) * 0.5f, extent = (localBound.max - localBound.min) * 0.5f;
+
+    switch (shape)
+    {
+    case Box:
+        localPoint = center + glm::vec3(localDirection.x < 0 ? -extent.x : extent.x, localDirection.y < 0 ? -extent.y : extent.y, localDirection.z < 0 ? -extent.z : extent.z);
+        break;
+    case Sphere:
+    {
+        float length = glm::length(localDirection), radius = std::max(extent.x, std::max(extent.y, extent.z));
+        localPoint = length > 1e-12f ? center + localDirection * (radius / length) : center;
+        break;
+    }
+    default:
+        localPoint = mesh->GetSupportPoint(localDirection, hint);
+        break;
+    }
+    return glm::vec3(model * glm::vec4(localPoint, 1.0f));
+}
+
+void Collider::UpdateBound()
+{
+    // Arvo's method: transform the local box center, then the extents by the absolute rotation-scale block
+    const glm::mat4& model = transform->model;
+    glm::vec3 center = (localBound.min + localBound.max) * 0.5f, extent = (localBound.max - localBound.min) * 0.5f;
+    glm::vec3 worldCenter = glm::vec3(model * glm::vec4(center, 1.0f)), worldExtent;
+    for (int i = 0; i < 3; i++)
+        worldExtent[i] = std::abs(model[0][i]) * extent.x + std::abs(model[1][i]) * extent.y + std::abs(model[2][i]) * extent.z;
+
+    bound.min = worldCenter - worldExtent;
+    bound.max = worldCenter + worldExtent;
+}
\ No newline at end of file
@@ -2,6 +2,10 @@
 #include <vector>
 #include <unordered_map>
 #include "../Core/GameObject.h"
+#include "Broadphase.h"
+#include "Narrowphase.h"
+#include "../Resources/Resource.h"
+#include "../Core/JobSystem.h"
 #include "../../3rdParty/GLM/glm.hpp"
 #include "../../3rdParty/GLM/gtc/quaternion.hpp"
 #include "../../3rdParty/GLM/gtc/matrix_transform.hpp"
@@ -10,33 +14,59 @@
 #include "../../3rdParty/GLM/ext/quaternion_trigonometric.hpp"
 
 const float dt = 1.0f / 60;
+const int maxSubSteps = 5;
+const glm::vec3 gravity = glm::vec3(0, -9.81f, 0);
 
 struct Collider;
 struct Physics
 {
-	//void GenerateColliders(const std::vector<GameObject*>& gameobjects);
-	//void UpdatePhysics();
-	//void IntegrateForce();
-	//void HandleBoardCollisions();
-	//void HandleBoardCollisions();
-	//void IntegrateVelocity();
-};
+	std::vector<Collider> colliders;
+	Broadphase broadphase;
+	std::vector<std::pair<int, int>> candidatePairs;
+	std::vector<Narrowphase> narrowphases; // One per job thread, indexed by JobSystem::ThreadIndex
+	std::vector<std::vector<Contact>> rangeContacts; // Contacts of each candidate pair range, merged in pair order
+	std::vector<Contact> contacts;
+	JobSystem* jobs = nullptr; // Engine's scheduler, without one every step runs on the calling thread
+	int solverIterations = 4;
+	glm::vec3 boardMin = glm::vec3(-50, 0, -50), boardMax = glm::vec3(50, 100, 50);
+	float restitution = 0.5f, friction = 0.2f, restSpeed = 0.5f;
+	bool collidersDirty = true;
+	uint64_t colliderVersion = 0; // ComponentStore version the collider pointers were taken at
+	uint64_t meshVersion = 0; // Resource mesh version the collider shapes were chosen at
 
-struct AABB
-{
-	glm::vec3 min, max;
+	void GenerateColliders(ComponentStore& components, Resource* resource);
+	// Colliders hold raw pointers into the component pools, any add or remove since they were taken rebuilds them
+	bool CollidersStale(const ComponentStore& components, const Resource* resource) const
+	{
+		return collidersDirty || colliderVersion != components.version || meshVersion != resource->meshVersion;
+	}
+	void UpdatePhysics();
+	void UpdateKinematic();
+	void IntegrateForce();
+	void DetectCollisions();
+	void ResolveContacts();
+	void IntegrateVelocity();
+	void HandleBoardCollisions();
+	void UpdateBounds();
+	void UpdateBroadphase();
+	void MarkMoved();
+	JobSystem& Jobs() const { return jobs ? *jobs : JobSystem::Serial(); }
 };
 
 struct Collider
 {
+	enum Shape { Box, Sphere, Hull } shape;
 	TransformComponent* transform;
 	RendererComponent* renderer;
 	RigidbodyComponent* rigidbody;
+	const MeshData* mesh;
 	AABB bound, localBound;
-	struct MeshData 
-	{
-		std::vector<glm::vec3> vertices;
-		std::vector<glm::vec3> normals;
-		std::vector<uint32_t> indices;
-	} meshData;
+	int proxyId;
+
+	// A body under a parent follows it instead of simulating: kinematic, moved by the hierarchy and immovable in contacts
+	bool IsKinematic() const { return transform->parent != TransformComponent::noParent; }
+	bool IsDynamic() const { return rigidbody->enabled && rigidbody->type == RigidbodyComponent::Dynamic && rigidbody->mass > 0 && !IsKinematic(); }
+	float InverseMass() const { return IsDynamic() ? 1.0f / rigidbody->mass : 0.0f; }
+	void UpdateBound();
+	glm::vec3 Support(const glm::vec3& direction, int* hint = nullptr) const; // hint: hull vertex to start the search from
 };
\ No newline at end of file
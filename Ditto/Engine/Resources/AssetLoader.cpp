@@ -0,0 +1,88 @@
+#include "AssetLoader.h"
+#include <chrono>
+#include <limits>
+
+AssetLoader::AssetLoader()
+{
+    worker = std::thread(&AssetLoader::WorkerLoop, this);
+}
+
+AssetLoader::~AssetLoader()
+{
+    // Jobs that have not started are dropped, the one in flight finishes first
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true; jobs.clear();
+    }
+    jobQueued.notify_one();
+    worker.join();
+}
+
+void AssetLoader::Load(std::function<void()> job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    jobQueued.notify_one();
+}
+
+void AssetLoader::Upload(std::function<void()> task)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    uploads.push_back(std::move(task));
+}
+
+size_t AssetLoader::ProcessUploads(double budgetMs)
+{
+    auto start = std::chrono::steady_clock::now();
+    size_t count = 0;
+    do
+    {
+        std::function<void()> task;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (uploads.empty()) break;
+            task = std::move(uploads.front()); uploads.pop_front();
+        }
+        task(); count++;
+    } while (std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() < budgetMs);
+    return count;
+}
+
+void AssetLoader::Flush()
+{
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobsDone.wait(lock, [this] { return jobs.empty() && !working; });
+        }
+        // Uploads may queue further jobs or uploads, so loop until a pass finds nothing left
+        if (ProcessUploads(std::numeric_limits<double>::infinity()) == 0 && !Busy()) return;
+    }
+}
+
+bool AssetLoader::Busy()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return working || !jobs.empty() || !uploads.empty();
+}
+
+void AssetLoader::WorkerLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        jobQueued.wait(lock, [this] { return stopping || !jobs.empty(); });
+        if (stopping) return;
+
+        std::function<void()> job = std::move(jobs.front()); jobs.pop_front();
+        working = true;
+        lock.unlock();
+        job();
+        lock.lock();
+        working = false;
+        if (jobs.empty()) jobsDone.notify_all();
+    }
+}
\ No newline at end of file
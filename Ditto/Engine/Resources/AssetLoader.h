@@ -0,0 +1,32 @@
+#pragma once
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+
+// Background loader: jobs run in order on one worker thread and hand their results to the main thread through
+// the upload queue. Uploads create GL objects, so they only run inside ProcessUploads, which stops once the
+// frame budget is spent and leaves the rest for the next frame.
+struct AssetLoader
+{
+	AssetLoader();
+	~AssetLoader();
+	AssetLoader(const AssetLoader&) = delete;
+	AssetLoader& operator=(const AssetLoader&) = delete;
+
+	void Load(std::function<void()> job);
+	void Upload(std::function<void()> task); // Safe to call from jobs
+	size_t ProcessUploads(double budgetMs);  // Runs at least one pending upload, returns how many ran
+	void Flush();                            // Blocks until every job and every upload they queued has run
+	bool Busy();
+
+private:
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable jobQueued, jobsDone;
+	std::deque<std::function<void()>> jobs, uploads;
+	bool working = false, stopping = false;
+
+	void WorkerLoop();
+};
\ No newline at end of file
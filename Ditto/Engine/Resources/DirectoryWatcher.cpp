@@ -0,0 +1,146 @@
+#include "DirectoryWatcher.h"
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+struct DirectoryRequest
+{
+    HANDLE directory = INVALID_HANDLE_VALUE;
+    OVERLAPPED overlapped = {};
+    DWORD buffer[4096]; // FILE_NOTIFY_INFORMATION records, DWORD aligned as the call requires
+
+    bool Issue()
+    {
+        ResetEvent(overlapped.hEvent);
+        return ReadDirectoryChangesW(directory, buffer, sizeof(buffer), FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME,
+            nullptr, &overlapped, nullptr) != 0;
+    }
+};
+#endif
+
+bool DirectoryWatcher::Open(const std::string& path)
+{
+    Close();
+    directory = path;
+#ifdef _WIN32
+    request = new DirectoryRequest();
+    request->directory = CreateFileA(path.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+        OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+    request->overlapped.hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+    if (request->directory == INVALID_HANDLE_VALUE || !request->overlapped.hEvent || !request->Issue())
+    {
+        std::cerr << "Failed to watch directory: " << path << std::endl;
+        Close();
+        return false;
+    }
+#elif defined(__linux__)
+    descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    // Editors either write the file in place or write a copy and rename it over the original
+    if (descriptor < 0 || inotify_add_watch(descriptor, path.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        std::cerr << "Failed to watch directory: " << path << std::endl;
+        Close();
+        return false;
+    }
+#else
+    return false;
+#endif
+    return true;
+}
+
+void DirectoryWatcher::Close()
+{
+#ifdef _WIN32
+    if (!request) return;
+    if (request->directory != INVALID_HANDLE_VALUE)
+    {
+        // The system may still write into the buffer until the cancelled read completes
+        DWORD bytes = 0;
+        if (CancelIoEx(request->directory, &request->overlapped) || GetLastError() != ERROR_NOT_FOUND)
+            GetOverlappedResult(request->directory, &request->overlapped, &bytes, TRUE);
+        CloseHandle(request->directory);
+    }
+    if (request->overlapped.hEvent) CloseHandle(request->overlapped.hEvent);
+    delete request; request = nullptr;
+#else
+    if (descriptor >= 0) close(descriptor);
+    descriptor = -1;
+#endif
+}
+
+bool DirectoryWatcher::IsOpen() const
+{
+#ifdef _WIN32
+    return request != nullptr;
+#else
+    return descriptor >= 0;
+#endif
+}
+
+void DirectoryWatcher::Add(std::vector<std::string>& changed, const std::string& name) const
+{
+    std::string path = (std::filesystem::path(directory) / name).string();
+    if (std::find(changed.begin(), changed.end(), path) == changed.end()) changed.push_back(path);
+}
+
+void DirectoryWatcher::AddAll(std::vector<std::string>& changed) const
+{
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error))
+        if (entry.is_regular_file(error)) Add(changed, entry.path().filename().string());
+}
+
+std::vector<std::string> DirectoryWatcher::Poll()
+{
+    std::vector<std::string> changed;
+    if (!IsOpen()) return changed;
+#ifdef _WIN32
+    DWORD bytes = 0;
+    if (!GetOverlappedResult(request->directory, &request->overlapped, &bytes, FALSE)) return changed; // Still waiting
+
+    // Zero bytes means the buffer overflowed and the individual changes are lost
+    if (bytes == 0) AddAll(changed);
+    for (const char* record = reinterpret_cast<const char*>(request->buffer); bytes > 0;)
+    {
+        const FILE_NOTIFY_INFORMATION* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(record);
+        if (info->Action == FILE_ACTION_ADDED || info->Action == FILE_ACTION_MODIFIED || info->Action == FILE_ACTION_RENAMED_NEW_NAME)
+        {
+            int length = static_cast<int>(info->FileNameLength / sizeof(WCHAR));
+            std::string name(WideCharToMultiByte(CP_UTF8, 0, info->FileName, length, nullptr, 0, nullptr, nullptr), '\0');
+            WideCharToMultiByte(CP_UTF8, 0, info->FileName, length, name.data(), static_cast<int>(name.size()), nullptr, nullptr);
+            Add(changed, name);
+        }
+        if (info->NextEntryOffset == 0) break;
+        record += info->NextEntryOffset;
+    }
+    if (!request->Issue())
+    {
+        std::cerr << "Stopped watching directory: " << directory << std::endl;
+        Close();
+    }
+#elif defined(__linux__)
+    alignas(inotify_event) char buffer[4096];
+    for (;;)
+    {
+        ssize_t length = read(descriptor, buffer, sizeof(buffer));
+        if (length <= 0) break; // EAGAIN: nothing left to read
+        for (ssize_t offset = 0; offset < length;)
+        {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            if (event->mask & IN_Q_OVERFLOW) AddAll(changed);
+            else if (event->len > 0) Add(changed, event->name);
+            offset += sizeof(inotify_event) + event->len;
+        }
+    }
+#endif
+    return changed;
+}
\ No newline at end of file
@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Reports the files in one directory, not its subdirectories, that were written or renamed into place since the
+// last Poll. Poll never blocks: Windows keeps an overlapped ReadDirectoryChangesW outstanding, Linux reads a
+// non-blocking inotify descriptor. When the system drops events every file in the directory is reported.
+struct DirectoryWatcher
+{
+	DirectoryWatcher() = default;
+	DirectoryWatcher(const std::string& path) { Open(path); }
+	~DirectoryWatcher() { Close(); }
+	DirectoryWatcher(const DirectoryWatcher&) = delete;
+	DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+	bool Open(const std::string& path);
+	void Close();
+	bool IsOpen() const;
+	std::vector<std::string> Poll(); // directory/name of each changed file, once per call
+
+private:
+	std::string directory;
+	void AddAll(std::vector<std::string>& changed) const;
+	void Add(std::vector<std::string>& changed, const std::string& name) const;
+#ifdef _WIN32
+	struct DirectoryRequest* request = nullptr; // Directory handle, OVERLAPPED and the buffer the system writes into
+#else
+	int descriptor = -1;
+#endif
+};
\ No newline at end of file
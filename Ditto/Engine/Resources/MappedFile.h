@@ -0,0 +1,25 @@
+#pragma once
+#include <string>
+#include <cstddef>
+
+// Read-only memory mapping of a whole file. The view stays valid until Close or destruction.
+struct MappedFile
+{
+	const char* data = nullptr;
+	size_t size = 0;
+
+	MappedFile() = default;
+	MappedFile(const std::string& path) { Open(path); }
+	~MappedFile() { Close(); }
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const std::string& path);
+	void Close();
+	bool IsOpen() const { return data != nullptr; }
+
+private:
+#ifdef _WIN32
+	void* fileHandle = nullptr; void* mappingHandle = nullptr;
+#endif
+};
\ No newline at end of file
@@ -1,145 +1,604 @@
 #include "Resource.h"
+#include "MappedFile.h"
 #include <filesystem>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <charconv>
+#include <climits>
+#include <cmath>
+#include <cstring>
 #include "../../3rdParty/GLM/glm.hpp"
 #include "../../3rdParty/GLAD/glad.h"
 #include "../../3rdParty/GLFW/glfw3.h"
 
-Resource::Resource()
+Resource::Resource(bool _createGeometry) : createGeometry(_createGeometry)
 {
-    cubeModel = new ModelData("Assets/Models/Cube.obj");
-    sphereModel = new ModelData("Assets/Models/Sphere.obj");
-    planeModel = new ModelData("Assets/Models/Plane.obj");
-	cubeMesh = new MeshData("Assets/Models/Cube.obj");
-    sphereMesh = new MeshData("Assets/Models/Sphere.obj");
-	planeMesh = new MeshData("Assets/Models/Plane.obj");
+    cube = GetMesh(cubePath);
+    sphere = GetMesh(spherePath);
+    plane = GetMesh(planePath);
+}
+
+Resource::~Resource()
+{
+    for (ModelData* model : models) delete model;
+    for (MeshData* mesh : meshes) delete mesh;
+}
+
+struct LoadedMesh { ModelData model; MeshData mesh; bool succeeded = false; };
+
+MeshHandle Resource::GetMesh(const std::string& path)
+{
+    // Different spellings of one file share a handle
+    std::string key = std::filesystem::path(path).lexically_normal().generic_string();
+    auto it = meshHandles.find(key);
+    if (it != meshHandles.end()) return it->second;
+
+    MeshHandle handle = static_cast<MeshHandle>(meshPaths.size());
+    models.push_back(new ModelData()); meshes.push_back(new MeshData()); meshPaths.push_back(key);
+    meshStates.push_back(MeshState::Loading); geometries.emplace_back();
+    meshHandles.emplace(key, handle);
+
+    loader.Load([this, handle, key]
+    {
+        auto loaded = std::make_shared<LoadedMesh>();
+        loaded->succeeded = LoadMesh(key, &loaded->model, &loaded->mesh); // Reports its own failure
+        loader.Upload([this, handle, loaded]
+        {
+            // Moved into the registered objects so pointers handed out while loading stay valid
+            *models[handle] = std::move(loaded->model); *meshes[handle] = std::move(loaded->mesh);
+            meshStates[handle] = loaded->succeeded ? MeshState::Ready : MeshState::Failed;
+            meshVersion++;
+            // Buffer creation is the expensive part, queued on its own so it lands in a later slice of the budget
+            if (createGeometry && loaded->succeeded && !models[handle]->vertexData.empty())
+                loader.Upload([this, handle] { geometries[handle] = arena.Add(*models[handle]); });
+        });
+    });
+    return handle;
+}
+
+GeometryArena::~GeometryArena()
+{
+    if (VAO) glDeleteVertexArrays(1, &VAO);
+    if (VBO) glDeleteBuffers(1, &VBO);
+    if (EBO) glDeleteBuffers(1, &EBO);
+}
+
+static GLuint GrowBuffer(GLenum target, GLuint buffer, size_t usedSize, size_t newSize)
+{
+    GLuint grown;
+    glGenBuffers(1, &grown);
+    glBindBuffer(target, grown);
+    glBufferData(target, newSize, nullptr, GL_STATIC_DRAW);
+    if (buffer)
+    {
+        // Copied on the GPU, draws already queued against the old buffer keep it alive until they finish
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        if (usedSize) glCopyBufferSubData(GL_COPY_READ_BUFFER, target, 0, 0, usedSize);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glDeleteBuffers(1, &buffer);
+    }
+    return grown;
+}
+
+void GeometryArena::Reserve(uint32_t vertices, uint32_t indices)
+{
+    if (!VAO) glGenVertexArrays(1, &VAO);
+    glBindVertexArray(VAO);
+
+    if (vertices > vertexCapacity)
+    {
+        vertexCapacity = std::max(vertices, std::max(vertexCapacity * 2, 1u << 16));
+        VBO = GrowBuffer(GL_ARRAY_BUFFER, VBO, vertexCount * 6 * sizeof(float), vertexCapacity * 6 * sizeof(float));
+        // The attribute pointers captured the old buffer, point them at the new one
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(1);
+    }
+    if (indices > indexCapacity)
+    {
+        // The EBO binding is VAO state, binding the grown buffer while the VAO is bound replaces it
+        indexCapacity = std::max(indices, std::max(indexCapacity * 2, 1u << 18));
+        EBO = GrowBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO, indexCount * sizeof(unsigned int), indexCapacity * sizeof(unsigned int));
+    }
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+BaseGeometry GeometryArena::Add(const ModelData& model)
+{
+    BaseGeometry geometry;
+    geometry.vertexCount = static_cast<uint32_t>(model.vertexData.size() / 6);
+
+    // Indices stay relative to the mesh and baseVertex offsets them, meshes without any draw their vertices in order
+    std::vector<unsigned int> sequential;
+    std::span<const unsigned int> indices = model.indexData;
+    if (indices.empty())
+    {
+        sequential.resize(geometry.vertexCount);
+        for (uint32_t i = 0; i < geometry.vertexCount; i++) sequential[i] = i;
+        indices = sequential;
+    }
+
+    Reserve(vertexCount + geometry.vertexCount, indexCount + static_cast<uint32_t>(indices.size()));
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferSubData(GL_ARRAY_BUFFER, vertexCount * 6 * sizeof(float), model.vertexData.size() * sizeof(float), model.vertexData.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, indexCount * sizeof(unsigned int), indices.size() * sizeof(unsigned int), indices.data());
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    geometry.firstIndex = indexCount; geometry.baseVertex = static_cast<int32_t>(vertexCount);
+    geometry.indexCount = static_cast<uint32_t>(indices.size());
+    vertexCount += geometry.vertexCount; indexCount += geometry.indexCount;
+    return geometry;
 }
 
 ModelData::ModelData(const std::string& path)
 {
-    std::ifstream file(path);
+    LoadOBJ(path, this, nullptr);
+}
 
-    std::vector<glm::vec3> positions, normals;
-    //std::vector<glm::vec2> texCoords;
+MeshData::MeshData(const std::string& filePath)
+{
+    LoadOBJ(filePath, nullptr, this);
+}
+
+// Tokenizer over the mapped text: every helper advances a cursor in place and never allocates
+static bool IsSpace(char c) { return c == ' ' || c == '\t'; }
+static const char* SkipSpaces(const char* p, const char* end) { while (p < end && IsSpace(*p)) p++; return p; }
+static const char* SkipLine(const char* p, const char* end) { while (p < end && *p != '\n') p++; return p < end ? p + 1 : end; }
 
-    std::string line;
-    int lineNum = 0;
+static const char* ParseFloat(const char* p, const char* end, float& value)
+{
+    p = SkipSpaces(p, end);
+    if (p < end && *p == '+') p++;
+    auto result = std::from_chars(p, end, value);
+    if (result.ec != std::errc()) value = 0.0f;
+    return result.ptr;
+}
+
+static const char* ParseVec3(const char* p, const char* end, glm::vec3& value)
+{
+    p = ParseFloat(p, end, value.x); p = ParseFloat(p, end, value.y); return ParseFloat(p, end, value.z);
+}
 
-    while (std::getline(file, line))
+static const char* ParseIndex(const char* p, const char* end, int count, int& index)
+{
+    // OBJ indices are 1-based, negative ones count back from the latest element. An index outside the elements
+    // read so far is treated as missing.
+    int value = 0;
+    auto result = std::from_chars(p, end, value);
+    if (result.ec != std::errc() || value == 0 || value > count || value < -count) { index = -1; return result.ptr; }
+    index = value < 0 ? count + value : value - 1;
+    return result.ptr;
+}
+
+static const char* ParseCorner(const char* p, const char* end, int positionCount, int texCoordCount, int normalCount, ModelData::FaceIndices& corner)
+{
+    corner = ModelData::FaceIndices();
+    p = ParseIndex(p, end, positionCount, corner.posIdx);
+    if (p < end && *p == '/')
     {
-        lineNum++;
+        p = ParseIndex(p + 1, end, texCoordCount, corner.texIdx);
+        if (p < end && *p == '/') p = ParseIndex(p + 1, end, normalCount, corner.normIdx);
+    }
+    return p;
+}
 
-        if (!line.empty() && line.back() == '\r') line.pop_back();
-        if (line.empty() || line[0] == '#') continue;
+// Open-addressing map from a packed (position, normal) index pair to its deduplicated vertex
+struct VertexTable
+{
+    static constexpr uint64_t empty = UINT64_MAX;
+    std::vector<uint64_t> keys; std::vector<unsigned int> values; size_t count = 0;
+
+    VertexTable() { keys.assign(1024, empty); values.resize(1024); }
 
-        std::istringstream lineStream(line);
-        std::string prefix;
-        lineStream >> prefix;
+    static size_t Hash(uint64_t key) { key ^= key >> 33; key *= 0xff51afd7ed558ccdULL; key ^= key >> 33; return static_cast<size_t>(key); }
 
-        if (prefix == "v")
+    unsigned int FindOrInsert(uint64_t key, unsigned int value, bool& inserted)
+    {
+        if ((count + 1) * 2 > keys.size()) Grow();
+        size_t mask = keys.size() - 1;
+        for (size_t i = Hash(key) & mask;; i = (i + 1) & mask)
         {
-            glm::vec3 pos;
-            if (lineStream >> pos.x >> pos.y >> pos.z) positions.push_back(pos);
+            if (keys[i] == key) { inserted = false; return values[i]; }
+            if (keys[i] == empty) { keys[i] = key; values[i] = value; count++; inserted = true; return value; }
         }
-        else if (prefix == "vn")
+    }
+
+    void Grow()
+    {
+        std::vector<uint64_t> oldKeys(keys.size() * 2, empty); std::vector<unsigned int> oldValues(values.size() * 2);
+        oldKeys.swap(keys); oldValues.swap(values);
+        size_t mask = keys.size() - 1;
+        for (size_t j = 0; j < oldKeys.size(); j++)
         {
-            glm::vec3 norm;
-            if (lineStream >> norm.x >> norm.y >> norm.z) normals.push_back(glm::normalize(norm));
+            if (oldKeys[j] == empty) continue;
+            size_t i = Hash(oldKeys[j]) & mask;
+            while (keys[i] != empty) i = (i + 1) & mask;
+            keys[i] = oldKeys[j]; values[i] = oldValues[j];
         }
-        //else if (prefix == "vt")
-        //{
-        //    glm::vec2 tex;
-        //    if (lineStream >> tex.x >> tex.y)
-        //    {
-        //        tex.y = 1.0f - tex.y;
-        //        texCoords.push_back(tex);
-        //    }
-        //}
-        else if (prefix == "f")
-        {
-            std::vector<std::string> faceTokens;
-            std::string token;
+    }
+};
 
-            while (lineStream >> token) faceTokens.push_back(token);
+static void EmitCorner(ModelData* model, VertexTable& table, const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& normals, const ModelData::FaceIndices& corner)
+{
+    // Offset by one so a missing index never packs into the empty key
+    uint64_t key = (static_cast<uint64_t>(static_cast<uint32_t>(corner.posIdx + 1)) << 32) | static_cast<uint32_t>(corner.normIdx + 1);
+    bool inserted;
+    unsigned int index = table.FindOrInsert(key, static_cast<unsigned int>(model->vertexStorage.size() / 6), inserted);
+    model->indexStorage.push_back(index);
+    if (!inserted) return;
 
-            for (const auto& faceToken : faceTokens)
-            {
-                FaceIndices indices = ParseFaceIndices(faceToken);
+    // ParseIndex already bounded both indices
+    glm::vec3 pos = positions[corner.posIdx];
+    glm::vec3 norm = corner.normIdx >= 0 ? normals[corner.normIdx] : glm::vec3(0.0f, 1.0f, 0.0f);
 
-                glm::vec3 pos = glm::vec3(0.0f);
-                if (indices.posIdx >= 0 && indices.posIdx < positions.size()) pos = positions[indices.posIdx];
-                vertexData.push_back(pos.x); vertexData.push_back(pos.y); vertexData.push_back(pos.z);
+    model->vertexStorage.insert(model->vertexStorage.end(), { pos.x, pos.y, pos.z, norm.x, norm.y, norm.z });
+}
+
+static float VertexCacheScore(int cachePosition, unsigned int remaining, int cacheSize)
+{
+    if (remaining == 0) return -1.0f;
+    float score = 0.0f;
+    if (cachePosition >= 0) score = cachePosition < 3 ? 0.75f : std::pow(1.0f - float(cachePosition - 3) / float(cacheSize - 3), 1.5f);
+    return score + 2.0f * std::pow(float(remaining), -0.5f);
+}
 
-                glm::vec3 norm = glm::vec3(0.0f, 1.0f, 0.0f);
-                if (indices.normIdx >= 0 && indices.normIdx < normals.size()) norm = normals[indices.normIdx];
-                vertexData.push_back(norm.x); vertexData.push_back(norm.y); vertexData.push_back(norm.z);
+// Forsyth's linear-speed vertex cache optimisation: greedily emit the triangle whose vertices score best against a
+// simulated LRU cache, favouring vertices used recently and vertices with few triangles left to draw.
+static void OptimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount)
+{
+    const int cacheSize = 32;
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) return;
+
+    // Triangles around each vertex, packed by offset; the first remaining[v] entries are the ones not yet emitted
+    std::vector<unsigned int> offsets(vertexCount + 1, 0), remaining(vertexCount, 0), adjacent(triangleCount * 3);
+    for (unsigned int v : indices) remaining[v]++;
+    for (size_t v = 0; v < vertexCount; v++) offsets[v + 1] = offsets[v] + remaining[v];
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++) for (int k = 0; k < 3; k++) adjacent[fill[indices[t * 3 + k]]++] = static_cast<unsigned int>(t);
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    std::vector<char> emitted(triangleCount, 0);
+    for (size_t v = 0; v < vertexCount; v++) vertexScores[v] = VertexCacheScore(-1, remaining[v], cacheSize);
+
+    size_t best = 0; float bestScore = -1.0f;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        float score = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+        if (score > bestScore) { bestScore = score; best = t; }
+    }
+
+    std::vector<unsigned int> output; output.reserve(indices.size());
+    unsigned int cache[cacheSize + 3], nextCache[cacheSize + 3]; int cacheCount = 0;
+    size_t scanCursor = 0;
+
+    for (size_t n = 0; n < triangleCount; n++)
+    {
+        // Nothing in the cache has triangles left, continue from the next unemitted one in input order
+        if (best == SIZE_MAX) { while (emitted[scanCursor]) scanCursor++; best = scanCursor; }
+
+        emitted[best] = 1;
+        unsigned int triangle[3] = { indices[best * 3], indices[best * 3 + 1], indices[best * 3 + 2] };
+        output.insert(output.end(), triangle, triangle + 3);
+
+        for (unsigned int v : triangle)
+        {
+            unsigned int* list = &adjacent[offsets[v]];
+            for (unsigned int i = 0; i < remaining[v]; i++)
+                if (list[i] == best) { std::swap(list[i], list[remaining[v] - 1]); break; }
+            remaining[v]--;
+        }
 
-                // glm::vec2 tex = glm::vec2(0.0f);
-                // if (indices.texIdx >= 0 && indices.texIdx < texCoords.size()) tex = texCoords[indices.texIdx];
-                // vertexData.push_back(tex.x); vertexData.push_back(tex.y);
+        // Move the triangle's vertices to the front of the LRU cache, anything pushed past the end is evicted
+        int nextCount = 0;
+        for (unsigned int v : triangle) nextCache[nextCount++] = v;
+        for (int i = 0; i < cacheCount; i++)
+            if (cache[i] != triangle[0] && cache[i] != triangle[1] && cache[i] != triangle[2]) nextCache[nextCount++] = cache[i];
+        for (int i = cacheSize; i < nextCount; i++)
+        {
+            cachePosition[nextCache[i]] = -1;
+            vertexScores[nextCache[i]] = VertexCacheScore(-1, remaining[nextCache[i]], cacheSize);
+        }
+        cacheCount = std::min(nextCount, cacheSize);
+        for (int i = 0; i < cacheCount; i++)
+        {
+            cache[i] = nextCache[i]; cachePosition[cache[i]] = i;
+            vertexScores[cache[i]] = VertexCacheScore(i, remaining[cache[i]], cacheSize);
+        }
+
+        // The next triangle is picked among those touching the cache
+        best = SIZE_MAX; bestScore = -1.0f;
+        for (int i = 0; i < cacheCount; i++)
+        {
+            unsigned int v = cache[i];
+            for (unsigned int j = offsets[v]; j < offsets[v] + remaining[v]; j++)
+            {
+                size_t t = adjacent[j];
+                float score = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+                if (score > bestScore) { bestScore = score; best = t; }
             }
         }
     }
+    indices.swap(output);
+}
 
-    file.close();
-    vertexCount = vertexData.size() / 8;
+// Renumber vertices in order of first use so vertex fetches walk the buffer forward
+static void ReorderVertices(ModelData* model)
+{
+    std::vector<unsigned int> remap(model->vertexStorage.size() / 6, UINT_MAX);
+    std::vector<float> reordered(model->vertexStorage.size());
+    unsigned int next = 0;
+    for (unsigned int& index : model->indexStorage)
+    {
+        if (remap[index] == UINT_MAX)
+        {
+            std::copy_n(&model->vertexStorage[index * 6], 6, &reordered[next * 6]);
+            remap[index] = next++;
+        }
+        index = remap[index];
+    }
+    reordered.resize(next * 6);
+    model->vertexStorage.swap(reordered);
 }
 
-Resource::~Resource()
+bool LoadOBJ(const std::string& path, ModelData* model, MeshData* mesh)
 {
-    delete cubeModel; delete sphereModel; delete planeModel;
+    MappedFile file(path);
+    if (!file.IsOpen())
+    {
+        std::cerr << "Failed to open OBJ file: " << path << std::endl;
+        return false;
+    }
+
+    std::vector<glm::vec3> positions, normals;
+    VertexTable vertexTable;
+    int texCoordCount = 0;
+    if (model) { model->vertexStorage.clear(); model->indexStorage.clear(); }
+    if (mesh) mesh->indexStorage.clear();
+
+    const char* p = file.data; const char* end = file.data + file.size;
+    while (p < end)
+    {
+        p = SkipSpaces(p, end);
+        if (end - p < 2) break;
+
+        if (p[0] == 'v' && IsSpace(p[1]))
+        {
+            glm::vec3 pos; p = ParseVec3(p + 2, end, pos);
+            positions.push_back(pos);
+        }
+        else if (p[0] == 'v' && p[1] == 'n')
+        {
+            glm::vec3 norm; p = ParseVec3(p + 2, end, norm);
+            normals.push_back(glm::normalize(norm));
+        }
+        else if (p[0] == 'v' && p[1] == 't') texCoordCount++;
+        else if (p[0] == 'f' && IsSpace(p[1]))
+        {
+            // Fan-triangulate polygons on the fly, only the first and previous corner are kept
+            ModelData::FaceIndices first, previous, corner;
+            int positionCount = static_cast<int>(positions.size()), normalCount = static_cast<int>(normals.size());
+            p += 2;
+            for (int cornerCount = 0;; cornerCount++)
+            {
+                p = SkipSpaces(p, end);
+                const char* start = p;
+                p = ParseCorner(p, end, positionCount, texCoordCount, normalCount, corner);
+                if (p == start) break;
+
+                // A triangle with a missing position is dropped from both meshes
+                if (cornerCount >= 2 && first.posIdx >= 0 && previous.posIdx >= 0 && corner.posIdx >= 0)
+                {
+                    if (model)
+                    {
+                        EmitCorner(model, vertexTable, positions, normals, first);
+                        EmitCorner(model, vertexTable, positions, normals, previous);
+                        EmitCorner(model, vertexTable, positions, normals, corner);
+                    }
+                    if (mesh) mesh->indexStorage.insert(mesh->indexStorage.end(), { unsigned(first.posIdx), unsigned(previous.posIdx), unsigned(corner.posIdx) });
+                }
+                if (cornerCount == 0) first = corner;
+                previous = corner;
+            }
+        }
+        p = SkipLine(p, end);
+    }
+
+    if (model)
+    {
+        OptimizeVertexCache(model->indexStorage, model->vertexStorage.size() / 6);
+        ReorderVertices(model);
+        model->UseStorage();
+        model->vertexCount = static_cast<int>(model->vertexData.size() / 6);
+    }
+    if (mesh)
+    {
+        mesh->vertexStorage = std::move(positions);
+        mesh->UseStorage();
+        mesh->CalculateAABB();
+        mesh->BuildHull();
+    }
+    return true;
 }
 
-ModelData::FaceIndices ModelData::ParseFaceIndices(const std::string& token)
+// Header, then every array at a 16-byte aligned offset: vertexData, indexData, vertices, indices, hull, adjacencyOffsets, adjacency
+struct CookedMeshHeader
 {
-    FaceIndices indices;
-    std::vector<std::string> parts;
-    std::stringstream ss(token);
-    std::string part;
+    char magic[4]; uint32_t version;
+    uint32_t renderVertexCount, renderIndexCount, vertexCount, indexCount, hullVertexCount, adjacencyCount;
+    float aabbMin[3], aabbMax[3];
+    uint64_t offsets[7], fileSize;
+};
+const int COOKED_MESH_SECTIONS = 7;
 
-    while (std::getline(ss, part, '/')) parts.push_back(part);
-    if (!parts[0].empty()) indices.posIdx = std::stoi(parts[0]) - 1;
-    if (parts.size() > 1 && !parts[1].empty()) indices.texIdx = std::stoi(parts[1]) - 1;
-    if (parts.size() > 2 && !parts[2].empty()) indices.normIdx = std::stoi(parts[2]) - 1;
+const uint32_t COOKED_MESH_VERSION = 2;
+const char COOKED_MESH_MAGIC[4] = { 'M', 'S', 'H', '\0' };
+const uint64_t COOKED_MESH_ALIGNMENT = 16;
 
-    return indices;
+std::string CookedMeshPath(const std::string& objPath)
+{
+    return std::filesystem::path(objPath).replace_extension(".mesh").string();
 }
 
-MeshData::MeshData(const std::string& filePath)
+bool CookMesh(const std::string& cookedPath, const ModelData& model, const MeshData& mesh)
 {
-    std::ifstream file(filePath);
+    CookedMeshHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, COOKED_MESH_MAGIC, 4);
+    header.version = COOKED_MESH_VERSION;
+    header.renderVertexCount = static_cast<uint32_t>(model.vertexData.size() / 6);
+    header.renderIndexCount = static_cast<uint32_t>(model.indexData.size());
+    header.vertexCount = static_cast<uint32_t>(mesh.vertices.size());
+    header.indexCount = static_cast<uint32_t>(mesh.indices.size());
+    header.hullVertexCount = static_cast<uint32_t>(mesh.hull.size());
+    header.adjacencyCount = static_cast<uint32_t>(mesh.adjacency.size());
+    memcpy(header.aabbMin, &mesh.aabbMin, sizeof(header.aabbMin)); memcpy(header.aabbMax, &mesh.aabbMax, sizeof(header.aabbMax));
+
+    const void* sections[COOKED_MESH_SECTIONS] = { model.vertexData.data(), model.indexData.data(), mesh.vertices.data(), mesh.indices.data(),
+        mesh.hull.data(), mesh.adjacencyOffsets.data(), mesh.adjacency.data() };
+    uint64_t sizes[COOKED_MESH_SECTIONS] = { model.vertexData.size_bytes(), model.indexData.size_bytes(), mesh.vertices.size_bytes(), mesh.indices.size_bytes(),
+        mesh.hull.size_bytes(), mesh.adjacencyOffsets.size_bytes(), mesh.adjacency.size_bytes() };
+    uint64_t offset = sizeof(header);
+    for (int i = 0; i < COOKED_MESH_SECTIONS; i++)
+    {
+        offset = (offset + COOKED_MESH_ALIGNMENT - 1) / COOKED_MESH_ALIGNMENT * COOKED_MESH_ALIGNMENT;
+        header.offsets[i] = offset; offset += sizes[i];
+    }
+    header.fileSize = offset;
+
+    // Write to a temporary name first so a crash mid-write never leaves a valid-looking cooked file
+    std::string tempPath = cookedPath + ".tmp";
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
     if (!file.is_open())
     {
-        std::cerr << "Failed to open OBJ file: " << filePath << std::endl;
-        return;
+        std::cerr << "Failed to open file for writing: " << tempPath << std::endl;
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    const char padding[COOKED_MESH_ALIGNMENT] = {};
+    for (int i = 0; i < COOKED_MESH_SECTIONS; i++)
+    {
+        file.write(padding, header.offsets[i] - static_cast<uint64_t>(file.tellp()));
+        file.write(static_cast<const char*>(sections[i]), sizes[i]);
+    }
+    file.close();
+    if (!file)
+    {
+        std::cerr << "Failed to write cooked mesh: " << tempPath << std::endl;
+        return false;
     }
 
-    std::string line;
-    while (std::getline(file, line))
+    std::error_code error;
+    std::filesystem::rename(tempPath, cookedPath, error);
+    if (error)
     {
-        if (!line.empty() && line.back() == '\r') line.pop_back();
-        if (line.empty() || line[0] == '#') continue;
+        std::cerr << "Failed to replace cooked mesh " << cookedPath << ": " << error.message() << std::endl;
+        return false;
+    }
+    return true;
+}
 
-        std::istringstream lineStream(line);
-        std::string prefix; lineStream >> prefix;
+static bool IndicesBelow(const unsigned int* indices, uint64_t count, uint64_t limit)
+{
+    for (uint64_t i = 0; i < count; i++) if (indices[i] >= limit) return false;
+    return true;
+}
 
-        if (prefix == "v")
-        {
-            glm::vec3 pos;
-            if (lineStream >> pos.x >> pos.y >> pos.z) vertices.push_back(pos);
-        }
-        else if (prefix == "f")
+bool LoadCookedMesh(const std::string& cookedPath, ModelData* model, MeshData* mesh)
+{
+    auto mapping = std::make_shared<MappedFile>(cookedPath);
+    if (!mapping->IsOpen()) return false;
+
+    CookedMeshHeader header;
+    if (mapping->size < sizeof(header)) { std::cerr << "Invalid cooked mesh: " << cookedPath << std::endl; return false; }
+    memcpy(&header, mapping->data, sizeof(header));
+
+    if (memcmp(header.magic, COOKED_MESH_MAGIC, 4) != 0 || header.fileSize != mapping->size)
+    {
+        std::cerr << "Invalid cooked mesh: " << cookedPath << std::endl;
+        return false;
+    }
+    if (header.version != COOKED_MESH_VERSION)
+    {
+        std::cerr << "Unsupported cooked mesh version: " << header.version << " (expected: " << COOKED_MESH_VERSION << ")" << std::endl;
+        return false;
+    }
+
+    // A hull that could not be built is stored without adjacency offsets
+    uint64_t hullOffsetCount = header.hullVertexCount ? header.hullVertexCount + 1ull : 0;
+    uint64_t sizes[COOKED_MESH_SECTIONS] = { header.renderVertexCount * 6ull * sizeof(float), header.renderIndexCount * 4ull, header.vertexCount * sizeof(glm::vec3),
+        header.indexCount * 4ull, header.hullVertexCount * sizeof(glm::vec3), hullOffsetCount * 4, header.adjacencyCount * 4ull };
+    for (int i = 0; i < COOKED_MESH_SECTIONS; i++)
+    {
+        if (header.offsets[i] % COOKED_MESH_ALIGNMENT != 0 || header.offsets[i] > mapping->size || sizes[i] > mapping->size - header.offsets[i])
         {
-            std::vector<std::string> faceTokens; std::string token;
-            while (lineStream >> token) faceTokens.push_back(token);
+            std::cerr << "Corrupt cooked mesh: " << cookedPath << std::endl;
+            return false;
         }
     }
-    file.close();
 
-    CalculateAABB();
+    // The arrays are used as indices without further checks, so a truncated or tampered file is rejected here
+    const char* base = mapping->data;
+    const unsigned int* adjacencyOffsets = reinterpret_cast<const unsigned int*>(base + header.offsets[5]);
+    bool valid = IndicesBelow(reinterpret_cast<const unsigned int*>(base + header.offsets[1]), header.renderIndexCount, header.renderVertexCount)
+        && IndicesBelow(reinterpret_cast<const unsigned int*>(base + header.offsets[3]), header.indexCount, header.vertexCount)
+        && IndicesBelow(reinterpret_cast<const unsigned int*>(base + header.offsets[6]), header.adjacencyCount, header.hullVertexCount);
+    if (hullOffsetCount == 0) valid &= header.adjacencyCount == 0;
+    else valid &= adjacencyOffsets[0] == 0 && adjacencyOffsets[header.hullVertexCount] == header.adjacencyCount;
+    for (uint64_t i = 1; valid && i < hullOffsetCount; i++) valid = adjacencyOffsets[i - 1] <= adjacencyOffsets[i];
+    if (!valid)
+    {
+        std::cerr << "Corrupt cooked mesh: " << cookedPath << std::endl;
+        return false;
+    }
+
+    // Point the views straight into the mapping, the shared mapping lives as long as either user
+    if (model)
+    {
+        model->vertexStorage.clear(); model->indexStorage.clear();
+        model->vertexData = { reinterpret_cast<const float*>(base + header.offsets[0]), header.renderVertexCount * 6ull };
+        model->indexData = { reinterpret_cast<const unsigned int*>(base + header.offsets[1]), header.renderIndexCount };
+        model->vertexCount = static_cast<int>(header.renderVertexCount);
+        model->mapping = mapping;
+    }
+    if (mesh)
+    {
+        mesh->vertexStorage.clear(); mesh->indexStorage.clear(); mesh->hullStorage.clear(); mesh->adjacencyOffsetStorage.clear(); mesh->adjacencyStorage.clear();
+        mesh->vertices = { reinterpret_cast<const glm::vec3*>(base + header.offsets[2]), header.vertexCount };
+        mesh->indices = { reinterpret_cast<const unsigned int*>(base + header.offsets[3]), header.indexCount };
+        mesh->hull = { reinterpret_cast<const glm::vec3*>(base + header.offsets[4]), header.hullVertexCount };
+        mesh->adjacencyOffsets = { reinterpret_cast<const unsigned int*>(base + header.offsets[5]), hullOffsetCount };
+        mesh->adjacency = { reinterpret_cast<const unsigned int*>(base + header.offsets[6]), header.adjacencyCount };
+        memcpy(&mesh->aabbMin, header.aabbMin, sizeof(header.aabbMin)); memcpy(&mesh->aabbMax, header.aabbMax, sizeof(header.aabbMax));
+        mesh->mapping = mapping;
+    }
+    return true;
+}
+
+bool LoadMesh(const std::string& objPath, ModelData* model, MeshData* mesh)
+{
+    std::string cookedPath = CookedMeshPath(objPath);
+    std::error_code sourceError, cookedError;
+    auto sourceTime = std::filesystem::last_write_time(objPath, sourceError);
+    auto cookedTime = std::filesystem::last_write_time(cookedPath, cookedError);
+
+    // Without the OBJ a cooked file is all there is, so ship-only builds can drop the sources. A cooked file that fails
+    // validation is rebuilt from the OBJ like a stale one.
+    if (!cookedError && (sourceError || cookedTime >= sourceTime) && LoadCookedMesh(cookedPath, model, mesh)) return true;
+
+    if (!LoadOBJ(objPath, model, mesh)) return false;
+    if (model && mesh) CookMesh(cookedPath, *model, *mesh);
+    return true;
 }
 
 void MeshData::CalculateAABB()
@@ -171,17 +630,194 @@ glm::vec3 MeshData::GetAABBSize() const
     return aabbMax - aabbMin;
 }
 
-glm::vec3 MeshData::GetSupportPoint(const glm::vec3& direction) const
+// Quickhull: start from a tetrahedron of extreme points, then repeatedly take the point furthest outside some face,
+// remove every face it sees and close the hole with a fan from the horizon to the point. Points are assigned to the
+// face they lie outside of, the rest are inside and dropped. Returns false when the points span no volume.
+static bool BuildConvexHull(std::span<const glm::vec3> points, std::vector<glm::vec3>& hullVertices, std::vector<unsigned int>& hullTriangles)
 {
-    float maxDot = -std::numeric_limits<float>::max();
-    glm::vec3 supportPoint = vertices[0];
-    glm::vec3 normalizedDir = glm::normalize(direction);
+    struct Face { unsigned int v[3]; glm::vec3 normal; float offset; std::vector<unsigned int> outside; bool alive; };
+    if (points.size() < 4) return false;
 
-    for (const auto& vertex : vertices)
+    glm::vec3 minimum = points[0], maximum = points[0];
+    for (const glm::vec3& point : points) minimum = glm::min(minimum, point), maximum = glm::max(maximum, point);
+    glm::vec3 size = maximum - minimum;
+    const float epsilon = 1e-5f * (size.x + size.y + size.z);
+    if (!(epsilon > 0)) return false;
+
+    // Initial tetrahedron: the widest pair of axis extremes, then the points furthest from their line and plane
+    unsigned int extremes[6] = {};
+    for (unsigned int i = 0; i < points.size(); i++)
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (points[i][axis] < points[extremes[axis * 2]][axis]) extremes[axis * 2] = i;
+            if (points[i][axis] > points[extremes[axis * 2 + 1]][axis]) extremes[axis * 2 + 1] = i;
+        }
+    unsigned int v0 = extremes[0], v1 = extremes[1];
+    for (int axis = 1; axis < 3; axis++)
+        if (glm::distance(points[extremes[axis * 2]], points[extremes[axis * 2 + 1]]) > glm::distance(points[v0], points[v1]))
+            v0 = extremes[axis * 2], v1 = extremes[axis * 2 + 1];
+
+    unsigned int v2 = v0; float best = 0;
+    glm::vec3 line = glm::normalize(points[v1] - points[v0]);
+    for (unsigned int i = 0; i < points.size(); i++)
+    {
+        glm::vec3 offset = points[i] - points[v0];
+        float distance = glm::length(offset - line * glm::dot(offset, line));
+        if (distance > best) best = distance, v2 = i;
+    }
+    if (best <= epsilon) return false;
+
+    unsigned int v3 = v0; best = 0;
+    glm::vec3 planeNormal = glm::normalize(glm::cross(points[v1] - points[v0], points[v2] - points[v0]));
+    for (unsigned int i = 0; i < points.size(); i++)
+    {
+        float distance = std::abs(glm::dot(points[i] - points[v0], planeNormal));
+        if (distance > best) best = distance, v3 = i;
+    }
+    if (best <= epsilon) return false;
+
+    // Each directed edge maps to the live face that has it, the neighbour across (a, b) is the owner of (b, a)
+    std::vector<Face> faces;
+    std::unordered_map<uint64_t, size_t> edgeFaces;
+    auto edgeKey = [](unsigned int a, unsigned int b) { return (static_cast<uint64_t>(a) << 32) | b; };
+    auto addFace = [&](unsigned int a, unsigned int b, unsigned int c)
     {
-        float dot = glm::dot(vertex, normalizedDir);
-        if (dot > maxDot) { maxDot = dot; supportPoint = vertex; }
+        Face face = { { a, b, c }, glm::cross(points[b] - points[a], points[c] - points[a]), 0, {}, true };
+        float length = glm::length(face.normal);
+        face.normal = length > 0 ? face.normal / length : glm::vec3(0);
+        face.offset = glm::dot(face.normal, points[a]);
+        for (int e = 0; e < 3; e++) edgeFaces[edgeKey(face.v[e], face.v[(e + 1) % 3])] = faces.size();
+        faces.push_back(std::move(face));
+    };
+    // Wind the tetrahedron so every normal points away from the fourth vertex
+    if (glm::dot(points[v3] - points[v0], planeNormal) > 0) std::swap(v1, v2);
+    addFace(v0, v1, v2); addFace(v0, v3, v1); addFace(v1, v3, v2); addFace(v2, v3, v0);
+
+    auto assign = [&](unsigned int point, size_t firstFace)
+    {
+        for (size_t f = firstFace; f < faces.size(); f++)
+        {
+            if (!faces[f].alive || glm::dot(faces[f].normal, points[point]) - faces[f].offset <= epsilon) continue;
+            faces[f].outside.push_back(point);
+            return;
+        }
+    };
+    for (unsigned int i = 0; i < points.size(); i++) if (i != v0 && i != v1 && i != v2 && i != v3) assign(i, 0);
+
+    std::vector<size_t> visible;
+    std::vector<std::pair<unsigned int, unsigned int>> horizon;
+    std::vector<unsigned int> orphans;
+    std::vector<uint8_t> visited;
+    for (size_t current = 0; current < faces.size(); current++)
+    {
+        if (!faces[current].alive || faces[current].outside.empty()) continue;
+
+        unsigned int eye = faces[current].outside[0]; float eyeDistance = -1;
+        for (unsigned int point : faces[current].outside)
+        {
+            float distance = glm::dot(faces[current].normal, points[point]) - faces[current].offset;
+            if (distance > eyeDistance) eyeDistance = distance, eye = point;
+        }
+
+        // Flood out from the face over the faces the eye sees, so the removed region stays connected even where
+        // rounding makes a distant face look visible; edges into faces it does not see form the horizon
+        visited.assign(faces.size(), 0);
+        visible.assign(1, current); visited[current] = 1;
+        horizon.clear(); orphans.clear();
+        for (size_t i = 0; i < visible.size(); i++)
+        {
+            const Face& face = faces[visible[i]];
+            for (int e = 0; e < 3; e++)
+            {
+                unsigned int a = face.v[e], b = face.v[(e + 1) % 3];
+                size_t neighbour = edgeFaces[edgeKey(b, a)];
+                if (visited[neighbour] == 1) continue;
+                if (glm::dot(faces[neighbour].normal, points[eye]) - faces[neighbour].offset > epsilon) { visited[neighbour] = 1; visible.push_back(neighbour); }
+                else horizon.emplace_back(a, b);
+            }
+        }
+
+        for (size_t f : visible)
+        {
+            Face& face = faces[f];
+            face.alive = false;
+            for (int e = 0; e < 3; e++) edgeFaces.erase(edgeKey(face.v[e], face.v[(e + 1) % 3]));
+            orphans.insert(orphans.end(), face.outside.begin(), face.outside.end());
+            std::vector<unsigned int>().swap(face.outside);
+        }
+
+        size_t firstNew = faces.size();
+        for (const auto& edge : horizon) addFace(edge.first, edge.second, eye);
+        for (unsigned int point : orphans) if (point != eye) assign(point, firstNew);
+    }
+
+    // Keep only the vertices the surviving faces use, renumbered in order of first use
+    std::vector<unsigned int> remap(points.size(), UINT_MAX);
+    hullVertices.clear(); hullTriangles.clear();
+    for (const Face& face : faces)
+    {
+        if (!face.alive) continue;
+        for (unsigned int v : face.v)
+        {
+            if (remap[v] == UINT_MAX) { remap[v] = static_cast<unsigned int>(hullVertices.size()); hullVertices.push_back(points[v]); }
+            hullTriangles.push_back(remap[v]);
+        }
+    }
+    return true;
+}
+
+void MeshData::BuildHull()
+{
+    hullStorage.clear(); adjacencyOffsetStorage.clear(); adjacencyStorage.clear();
+    std::vector<unsigned int> triangles;
+    if (BuildConvexHull(vertices, hullStorage, triangles))
+    {
+        std::vector<std::vector<unsigned int>> neighbours(hullStorage.size());
+        for (size_t i = 0; i + 2 < triangles.size(); i += 3)
+        {
+            for (int edge = 0; edge < 3; edge++)
+            {
+                unsigned int a = triangles[i + edge], b = triangles[i + (edge + 1) % 3];
+                neighbours[a].push_back(b); neighbours[b].push_back(a);
+            }
+        }
+
+        adjacencyOffsetStorage.assign(1, 0);
+        for (auto& list : neighbours)
+        {
+            std::sort(list.begin(), list.end());
+            list.erase(std::unique(list.begin(), list.end()), list.end());
+            adjacencyStorage.insert(adjacencyStorage.end(), list.begin(), list.end());
+            adjacencyOffsetStorage.push_back(static_cast<unsigned int>(adjacencyStorage.size()));
+        }
+    }
+    hull = hullStorage; adjacencyOffsets = adjacencyOffsetStorage; adjacency = adjacencyStorage;
+}
+
+glm::vec3 MeshData::GetSupportPoint(const glm::vec3& direction, int* hint) const
+{
+    // Flat meshes have no hull to climb, the support is the furthest of all their vertices
+    if (hull.empty())
+    {
+        size_t furthest = 0;
+        for (size_t i = 1; i < vertices.size(); i++) if (glm::dot(vertices[i], direction) > glm::dot(vertices[furthest], direction)) furthest = i;
+        return vertices[furthest];
+    }
+
+    // Hill-climb the hull from the previous answer; on a convex hull the local maximum is the support point
+    int current = hint && *hint >= 0 && *hint < static_cast<int>(hull.size()) ? *hint : 0;
+    float maxDot = glm::dot(hull[current], direction);
+
+    for (bool improved = true; improved;)
+    {
+        improved = false;
+        for (unsigned int i = adjacencyOffsets[current]; i < adjacencyOffsets[current + 1]; i++)
+        {
+            float dot = glm::dot(hull[adjacency[i]], direction);
+            if (dot > maxDot) { maxDot = dot; current = adjacency[i]; improved = true; break; }
+        }
     }
 
-    return supportPoint;
+    if (hint) *hint = current;
+    return hull[current];
 }
\ No newline at end of file
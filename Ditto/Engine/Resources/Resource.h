@@ -1,39 +1,141 @@
+#pragma once
 #include <string>
 #include <vector>
+#include <span>
+#include <memory>
+#include <cstdint>
+#include <unordered_map>
+#include "MappedFile.h"
+#include "AssetLoader.h"
 #include "../../3rdParty/GLM/glm.hpp"
+#include "../../3rdParty/GLAD/glad.h"
 
 struct ModelData; struct MeshData;
+using MeshHandle = uint32_t;
+
+// A mesh's range in the geometry arena, indexCount is zero until it has been uploaded
+struct BaseGeometry
+{
+	uint32_t firstIndex = 0, indexCount = 0;
+	int32_t baseVertex = 0;
+	uint32_t vertexCount = 0;
+};
+
+// Every mesh lives in one vertex buffer and one 32-bit index buffer behind a single VAO, so all of them can go out
+// in one multi-draw. Meshes are appended and never freed; a full buffer is doubled and its contents copied over.
+struct GeometryArena
+{
+	GLuint VAO = 0, VBO = 0, EBO = 0;
+	uint32_t vertexCount = 0, indexCount = 0, vertexCapacity = 0, indexCapacity = 0;
+
+	GeometryArena() = default;
+	~GeometryArena();
+	GeometryArena(const GeometryArena&) = delete;
+	GeometryArena& operator=(const GeometryArena&) = delete;
+
+	BaseGeometry Add(const ModelData& model);
+	void Reserve(uint32_t vertices, uint32_t indices);
+};
+
+// Mesh registry: every distinct path gets a handle on first request and keeps it for the lifetime of the Resource.
+// The file is parsed on the loader thread while the handle refers to empty data; the main thread then installs
+// the result and creates its GPU geometry from ProcessUploads. Paths that fail to load stay registered as Failed,
+// so they are not retried every frame.
 struct Resource
 {
+	enum class MeshState : uint8_t { Loading, Ready, Failed };
+	static constexpr MeshHandle invalidMesh = UINT32_MAX;
+	static constexpr const char* cubePath = "Assets/Models/Cube.obj";
+	static constexpr const char* spherePath = "Assets/Models/Sphere.obj";
+	static constexpr const char* planePath = "Assets/Models/Plane.obj";
+
 	std::string resourcePath = "../../Assets/Models";
-	ModelData* cubeModel, *sphereModel, *planeModel;
-	MeshData* cubeMesh, *sphereMesh, *planeMesh;
+	std::vector<ModelData*> models;
+	std::vector<MeshData*> meshes;
+	std::vector<std::string> meshPaths;
+	std::unordered_map<std::string, MeshHandle> meshHandles;
+	std::vector<MeshState> meshStates;
+	std::vector<BaseGeometry> geometries;
+	GeometryArena arena;
+	MeshHandle cube, sphere, plane;
+	uint64_t meshVersion = 0; // Bumped whenever a mesh finishes loading, holders of mesh data compare against it
+	double uploadBudget = 2.0; // Milliseconds of main-thread upload work per frame
+	bool createGeometry;
+	AssetLoader loader; // Declared last so the worker is joined before anything above is destroyed
 
-	Resource();
+	Resource(bool _createGeometry = true);
 	~Resource();
+
+	MeshHandle GetMesh(const std::string& path);
+	MeshHandle Resolve(const std::string& path, MeshHandle& cached) { if (cached == invalidMesh) cached = GetMesh(path); return cached; }
+	ModelData* GetModelData(MeshHandle handle) const { return handle < models.size() ? models[handle] : nullptr; }
+	MeshData* GetMeshData(MeshHandle handle) const { return handle < meshes.size() ? meshes[handle] : nullptr; }
+	const BaseGeometry* GetGeometry(MeshHandle handle) const { return handle < geometries.size() && geometries[handle].indexCount ? &geometries[handle] : nullptr; }
+	const std::string& GetMeshPath(MeshHandle handle) const { return meshPaths[handle]; }
+	bool IsReady(MeshHandle handle) const { return handle < meshStates.size() && meshStates[handle] == MeshState::Ready; }
+	size_t MeshCount() const { return meshPaths.size(); }
+
+	void ProcessUploads() { loader.ProcessUploads(uploadBudget); }
+	void Flush() { loader.Flush(); }
 };
 
+// Parses an OBJ in one pass over a memory mapping and fills whichever of the two outputs is non-null
+bool LoadOBJ(const std::string& path, ModelData* model, MeshData* mesh);
+// Cooked meshes are the parsed result of an OBJ laid out so a mapping of the file can be used in place
+std::string CookedMeshPath(const std::string& objPath);
+bool CookMesh(const std::string& cookedPath, const ModelData& model, const MeshData& mesh);
+bool LoadCookedMesh(const std::string& cookedPath, ModelData* model, MeshData* mesh);
+// Uses the cooked file when it is at least as new as the OBJ, otherwise parses the OBJ and cooks it
+bool LoadMesh(const std::string& objPath, ModelData* model, MeshData* mesh);
+
+// The public arrays are views: they point at the storage vectors after a parse, or straight into the mapped
+// cooked file after a cooked load. Writers fill the storage and call UseStorage.
 struct ModelData // For Rendering
 {
 	std::string modelName;
-	int vertexCount;
-	std::vector<float> vertexData;
+	int vertexCount = 0;
+	std::span<const float> vertexData; // Unique position + normal pairs, 6 floats each
+	std::span<const unsigned int> indexData; // Triangles ordered for the post-transform vertex cache
+	ModelData() = default;
 	ModelData(const std::string& path);
-	struct FaceIndices { int posIdx, texIdx, normIdx; };
-	FaceIndices ParseFaceIndices(const std::string& token);
+	ModelData(const ModelData&) = delete;
+	ModelData& operator=(const ModelData&) = delete;
+	ModelData& operator=(ModelData&&) = default; // Vector buffers move with their contents, so the views stay valid
+	struct FaceIndices { int posIdx = -1, texIdx = -1, normIdx = -1; };
+
+	std::vector<float> vertexStorage;
+	std::vector<unsigned int> indexStorage;
+	std::shared_ptr<MappedFile> mapping;
+	void UseStorage() { vertexData = vertexStorage; indexData = indexStorage; mapping.reset(); }
 };
 
 struct MeshData // For Physics
 {
-    std::vector<glm::vec3> vertices;
-    std::vector<unsigned int> indices;
+    std::span<const glm::vec3> vertices;
+    std::span<const unsigned int> indices;
+    std::span<const glm::vec3> hull; // Convex hull vertices, empty when the points are flat or degenerate
+    std::span<const unsigned int> adjacencyOffsets, adjacency; // Hull vertex neighbours for hill-climbing support queries
     glm::vec3 aabbMin, aabbMax;
 
+    MeshData() = default;
     MeshData(const std::string& filePath);
+    MeshData(const MeshData&) = delete;
+    MeshData& operator=(const MeshData&) = delete;
+    MeshData& operator=(MeshData&&) = default;
 
 	void CalculateAABB();
+	void BuildHull();
     bool CheckAABBCollision(const MeshData& other) const;
     glm::vec3 GetAABBCenter() const;
     glm::vec3 GetAABBSize() const;
-    glm::vec3 GetSupportPoint(const glm::vec3& direction) const;
+    glm::vec3 GetSupportPoint(const glm::vec3& direction, int* hint = nullptr) const;
+
+    std::vector<glm::vec3> vertexStorage, hullStorage;
+    std::vector<unsigned int> indexStorage, adjacencyOffsetStorage, adjacencyStorage;
+    std::shared_ptr<MappedFile> mapping;
+    void UseStorage()
+    {
+        vertices = vertexStorage; indices = indexStorage; hull = hullStorage;
+        adjacencyOffsets = adjacencyOffsetStorage; adjacency = adjacencyStorage; mapping.reset();
+    }
 };
\ No newline at end of file